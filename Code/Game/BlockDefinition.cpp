@@ -1,5 +1,6 @@
 #include "Game/BlockDefinition.hpp"
 
+#include "Game/Block.hpp"
 #include "Game/GameCommon.hpp"
 
 #include "Engine/Core/EngineCommon.hpp"
@@ -7,6 +8,8 @@
 
 
 std::vector<BlockDefinition> BlockDefinition::s_blockDefs;
+BlockProperties BlockDefinition::s_blockProperties[MAX_BLOCK_DEFINITIONS];
+AABB2 BlockDefinition::s_spriteUVs[BLOCK_SPRITESHEET_NUM_SPRITES];
 
 void BlockDefinition::InitializeBlockDefinitions()
 {
@@ -40,16 +43,38 @@ BlockDefinition::BlockDefinition(XmlElement const* element)
 
 void BlockDefinition::CreateNewBlockDef(std::string blockTypeName, bool visible, bool solid, bool opaque, bool isWater, IntVec2 const& topSpriteCoords, IntVec2 const& sideSpriteCoords, IntVec2 const& bottomSpriteCoords, int lightInfluence)
 {
+	GUARANTEE_OR_DIE((int)s_blockDefs.size() < (int)BLOCKTYPE_INVALID, "Too many block definitions");
+
+	int topSpriteIndex = topSpriteCoords.y * BLOCK_SPRITESHEET_GRID_SIZE + topSpriteCoords.x;
+	int sideSpriteIndex = sideSpriteCoords.y * BLOCK_SPRITESHEET_GRID_SIZE + sideSpriteCoords.x;
+	int bottomSpriteIndex = bottomSpriteCoords.y * BLOCK_SPRITESHEET_GRID_SIZE + bottomSpriteCoords.x;
+
 	BlockDefinition newBlockDef;
 	newBlockDef.m_name = blockTypeName;
 	newBlockDef.m_isVisible = visible;
 	newBlockDef.m_isOpaque = opaque;
 	newBlockDef.m_isSolid = solid;
 	newBlockDef.m_isWater = isWater;
-	newBlockDef.m_topTextureUVs = g_spritesheet->GetSpriteUVs(topSpriteCoords.y * 64 + topSpriteCoords.x);
-	newBlockDef.m_sideTextureUVs = g_spritesheet->GetSpriteUVs(sideSpriteCoords.y * 64 + sideSpriteCoords.x);
-	newBlockDef.m_bottomTextureUVs = g_spritesheet->GetSpriteUVs(bottomSpriteCoords.y * 64 + bottomSpriteCoords.x);
+	newBlockDef.m_topTextureUVs = g_spritesheet->GetSpriteUVs(topSpriteIndex);
+	newBlockDef.m_sideTextureUVs = g_spritesheet->GetSpriteUVs(sideSpriteIndex);
+	newBlockDef.m_bottomTextureUVs = g_spritesheet->GetSpriteUVs(bottomSpriteIndex);
 	newBlockDef.m_lightInfluence = lightInfluence;
+
+	BlockProperties& properties = s_blockProperties[s_blockDefs.size()];
+	properties.m_flags = 0;
+	properties.m_flags |= solid ? SOLID_BITMASK : 0;
+	properties.m_flags |= opaque ? OPAQUE_BITMASK : 0;
+	properties.m_flags |= visible ? VISIBLE_BITMASK : 0;
+	properties.m_flags |= isWater ? WATER_BITMASK : 0;
+	properties.m_lightInfluence = (uint8_t)lightInfluence;
+	properties.m_topSpriteIndex = (uint16_t)topSpriteIndex;
+	properties.m_sideSpriteIndex = (uint16_t)sideSpriteIndex;
+	properties.m_bottomSpriteIndex = (uint16_t)bottomSpriteIndex;
+
+	s_spriteUVs[topSpriteIndex] = newBlockDef.m_topTextureUVs;
+	s_spriteUVs[sideSpriteIndex] = newBlockDef.m_sideTextureUVs;
+	s_spriteUVs[bottomSpriteIndex] = newBlockDef.m_bottomTextureUVs;
+
 	s_blockDefs.push_back(newBlockDef);
 }
 
@@ -5,9 +5,35 @@
 #include "Engine/Math/Vec2.hpp"
 #include "Engine/Math/Vec3.hpp"
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
+
+constexpr unsigned char SOLID_BITMASK = 1;
+constexpr unsigned char OPAQUE_BITMASK = 2;
+constexpr unsigned char VISIBLE_BITMASK = 16;
+constexpr unsigned char WATER_BITMASK = 32;
+
+// The property table covers every byte value, so lookups never need a bounds check; ID 255 is BLOCKTYPE_INVALID and is never assigned
+constexpr int MAX_BLOCK_DEFINITIONS = 256;
+constexpr int BLOCK_SPRITESHEET_GRID_SIZE = 64;
+constexpr int BLOCK_SPRITESHEET_NUM_SPRITES = BLOCK_SPRITESHEET_GRID_SIZE * BLOCK_SPRITESHEET_GRID_SIZE;
+
+
+// Everything generation, meshing and lighting need to know about a block type, packed into 8 bytes
+// The whole table for every block type fits in a handful of cache lines and is read by reference on hot paths
+struct BlockProperties
+{
+public:
+	uint8_t m_flags = 0;
+	uint8_t m_lightInfluence = 0;
+	uint16_t m_topSpriteIndex = 0;
+	uint16_t m_sideSpriteIndex = 0;
+	uint16_t m_bottomSpriteIndex = 0;
+};
+static_assert(sizeof(BlockProperties) == 8, "Block properties are no longer packed");
+
 class BlockDefinition
 {
 public:
@@ -22,6 +48,8 @@ public:
 	bool m_isWater = false;
 
 	static std::vector<BlockDefinition> s_blockDefs;
+	static BlockProperties s_blockProperties[MAX_BLOCK_DEFINITIONS];
+	static AABB2 s_spriteUVs[BLOCK_SPRITESHEET_NUM_SPRITES];
 
 public:
 	~BlockDefinition() = default;
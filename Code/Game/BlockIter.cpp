@@ -12,110 +12,140 @@ BlockIter::BlockIter(Chunk* chunk, int blockIndex)
 {
 }
 
-Block* BlockIter::GetBlock() const
+bool BlockIter::IsValid() const
 {
-	if (!m_chunk)
-	{
-		return nullptr;
-	}
-	
-	return &m_chunk->m_blocks[m_blockIndex];
+	return m_chunk != nullptr;
 }
 
-BlockIter BlockIter::GetEastBlock() const
+BlockDefinitionID BlockIter::GetType() const
 {
-	if (m_chunk == nullptr)
-	{
-		return BlockIter(m_chunk, -1);
-	}
+	return m_chunk->GetBlockType(m_blockIndex);
+}
 
-	IntVec3 blockCoords = m_chunk->GetBlockCoordsFromIndex(m_blockIndex);
-	if (blockCoords.x == CHUNK_SIZE_X - 1)
-	{
-		return BlockIter(m_chunk->m_eastNeighbor, m_blockIndex & ~CHUNK_BITMASK_X);
-	}
+bool BlockIter::IsVisible() const
+{
+	return m_chunk->IsBlockVisible(m_blockIndex);
+}
 
-	return BlockIter(m_chunk, m_blockIndex + 1);
+bool BlockIter::IsSolid() const
+{
+	return m_chunk->IsBlockSolid(m_blockIndex);
 }
 
-BlockIter BlockIter::GetWestBlock() const
+bool BlockIter::IsOpaque() const
 {
-	if (m_chunk == nullptr)
-	{
-		return BlockIter(m_chunk, -1);
-	}
+	return m_chunk->IsBlockOpaque(m_blockIndex);
+}
 
-	IntVec3 blockCoords = m_chunk->GetBlockCoordsFromIndex(m_blockIndex);
-	if (blockCoords.x == 0)
-	{
-		return BlockIter(m_chunk->m_westNeighbor, m_blockIndex | CHUNK_BITMASK_X);
-	}
+bool BlockIter::IsWater() const
+{
+	return m_chunk->IsBlockWater(m_blockIndex);
+}
 
-	return BlockIter(m_chunk, m_blockIndex - 1);
+int BlockIter::GetIndoorLightInfluence() const
+{
+	return m_chunk->GetBlockIndoorLightInfluence(m_blockIndex);
 }
 
-BlockIter BlockIter::GetNorthBlock() const
+int BlockIter::GetOutdoorLightInfluence() const
 {
+	return m_chunk->GetBlockOutdoorLightInfluence(m_blockIndex);
+}
+
+template <Direction direction>
+BlockIter BlockIter::Step() const
+{
+	// Only the bits of the index along the step direction decide whether the step leaves the chunk
 	if (m_chunk == nullptr)
 	{
-		return BlockIter(m_chunk, -1);
+		return BlockIter(nullptr, -1);
 	}
 
-	IntVec3 blockCoords = m_chunk->GetBlockCoordsFromIndex(m_blockIndex);
-	if (blockCoords.y == CHUNK_SIZE_Y - 1)
+	if constexpr (direction == Direction::EAST)
 	{
-		return BlockIter(m_chunk->m_northNeighbor, m_blockIndex & ~(CHUNK_BITMASK_Y << CHUNK_XBITS));
+		if ((m_blockIndex & CHUNK_BITMASK_X) == CHUNK_BITMASK_X)
+		{
+			return BlockIter(m_chunk->m_eastNeighbor, m_blockIndex & ~CHUNK_BITMASK_X);
+		}
+		return BlockIter(m_chunk, m_blockIndex + 1);
 	}
-
-	return BlockIter(m_chunk, m_blockIndex + CHUNK_SIZE_X);
-}
-
-BlockIter BlockIter::GetSouthBlock() const
-{
-	if (m_chunk == nullptr)
+	else if constexpr (direction == Direction::WEST)
 	{
-		return BlockIter(m_chunk, -1);
+		if ((m_blockIndex & CHUNK_BITMASK_X) == 0)
+		{
+			return BlockIter(m_chunk->m_westNeighbor, m_blockIndex | CHUNK_BITMASK_X);
+		}
+		return BlockIter(m_chunk, m_blockIndex - 1);
 	}
-
-	IntVec3 blockCoords = m_chunk->GetBlockCoordsFromIndex(m_blockIndex);
-	if (blockCoords.y == 0)
+	else if constexpr (direction == Direction::NORTH)
 	{
-		return BlockIter(m_chunk->m_southNeighbor, m_blockIndex | (CHUNK_BITMASK_Y << CHUNK_XBITS));
+		if ((m_blockIndex & (CHUNK_BITMASK_Y << CHUNK_XBITS)) == (CHUNK_BITMASK_Y << CHUNK_XBITS))
+		{
+			return BlockIter(m_chunk->m_northNeighbor, m_blockIndex & ~(CHUNK_BITMASK_Y << CHUNK_XBITS));
+		}
+		return BlockIter(m_chunk, m_blockIndex + CHUNK_SIZE_X);
 	}
-
-	return BlockIter(m_chunk, m_blockIndex - CHUNK_SIZE_X);
-}
-
-BlockIter BlockIter::GetSkywardBlock() const
-{
-	if (m_chunk == nullptr)
+	else if constexpr (direction == Direction::SOUTH)
 	{
-		return BlockIter(m_chunk, -1);
+		if ((m_blockIndex & (CHUNK_BITMASK_Y << CHUNK_XBITS)) == 0)
+		{
+			return BlockIter(m_chunk->m_southNeighbor, m_blockIndex | (CHUNK_BITMASK_Y << CHUNK_XBITS));
+		}
+		return BlockIter(m_chunk, m_blockIndex - CHUNK_SIZE_X);
 	}
-
-	IntVec3 blockCoords = m_chunk->GetBlockCoordsFromIndex(m_blockIndex);
-	if (blockCoords.z == CHUNK_SIZE_Z - 1)
+	else if constexpr (direction == Direction::SKYWARD)
 	{
-		return BlockIter(nullptr, -1);
+		if (m_blockIndex >= CHUNK_BLOCKS_TOTAL - CHUNK_BLOCKS_PER_LAYER)
+		{
+			return BlockIter(nullptr, -1);
+		}
+		return BlockIter(m_chunk, m_blockIndex + CHUNK_BLOCKS_PER_LAYER);
+	}
+	else
+	{
+		if (m_blockIndex < CHUNK_BLOCKS_PER_LAYER)
+		{
+			return BlockIter(nullptr, -1);
+		}
+		return BlockIter(m_chunk, m_blockIndex - CHUNK_BLOCKS_PER_LAYER);
 	}
+}
 
-	return BlockIter(m_chunk, m_blockIndex + CHUNK_BLOCKS_PER_LAYER);
+template BlockIter BlockIter::Step<Direction::EAST>() const;
+template BlockIter BlockIter::Step<Direction::WEST>() const;
+template BlockIter BlockIter::Step<Direction::NORTH>() const;
+template BlockIter BlockIter::Step<Direction::SOUTH>() const;
+template BlockIter BlockIter::Step<Direction::SKYWARD>() const;
+template BlockIter BlockIter::Step<Direction::GROUNDWARD>() const;
+
+BlockIter BlockIter::GetEastBlock() const
+{
+	return Step<Direction::EAST>();
 }
 
-BlockIter BlockIter::GetGroundwardBlock() const
+BlockIter BlockIter::GetWestBlock() const
 {
-	if (m_chunk == nullptr)
-	{
-		return BlockIter(m_chunk, -1);
-	}
+	return Step<Direction::WEST>();
+}
 
-	IntVec3 blockCoords = m_chunk->GetBlockCoordsFromIndex(m_blockIndex);
-	if (blockCoords.z == 0)
-	{
-		return BlockIter(nullptr, -1);
-	}
+BlockIter BlockIter::GetNorthBlock() const
+{
+	return Step<Direction::NORTH>();
+}
 
-	return BlockIter(m_chunk, m_blockIndex - CHUNK_BLOCKS_PER_LAYER);
+BlockIter BlockIter::GetSouthBlock() const
+{
+	return Step<Direction::SOUTH>();
+}
+
+BlockIter BlockIter::GetSkywardBlock() const
+{
+	return Step<Direction::SKYWARD>();
+}
+
+BlockIter BlockIter::GetGroundwardBlock() const
+{
+	return Step<Direction::GROUNDWARD>();
 }
 
 Vec3 BlockIter::GetWorldCenter() const
@@ -129,67 +159,29 @@ Vec3 BlockIter::GetWorldCenter() const
 	return blockCoordsInChunkSpace + m_chunk->m_worldPosition + Vec3(0.5f, 0.5f, 0.5f);
 }
 
-Rgba8 BlockIter::GetFaceTintForLightInfluenceValues(Direction direction) const
+template <Direction direction>
+Rgba8 BlockIter::GetFaceTintForLightInfluenceValues(BlockIter const& neighborBlockIter) const
 {
-	Rgba8 color = Rgba8::WHITE;
-	int indoorLightInfluence = 0;
-	int outdoorLightInfluence = 0;
+	// Faces are shaded by direction so that edges stay readable without directional lighting
+	constexpr unsigned char faceShade = (direction == Direction::EAST || direction == Direction::WEST) ? 230 : ((direction == Direction::NORTH || direction == Direction::SOUTH) ? 200 : 255);
 
-	switch (direction)
+	if (IsWater())
 	{
-		case Direction::EAST:
-		{
-			color = Rgba8(230, 230, 230, 255);
-			Block* eastBlock = GetEastBlock().GetBlock();
-			indoorLightInfluence = eastBlock ? eastBlock->GetIndoorLightInfluence() : 0;
-			outdoorLightInfluence = eastBlock ? eastBlock->GetOutdoorLightInfluence() : 0;
-			break;
-		}
-		case Direction::WEST:
-		{
-			color = Rgba8(230, 230, 230, 255);
-			Block* westBlock = GetWestBlock().GetBlock();
-			indoorLightInfluence = westBlock ? westBlock->GetIndoorLightInfluence() : 0;
-			outdoorLightInfluence = westBlock ? westBlock->GetOutdoorLightInfluence() : 0;
-			break;
-		}
-		case Direction::NORTH:
-		{
-			color = Rgba8(200, 200, 200, 255);
-			Block* northBlock = GetNorthBlock().GetBlock();
-			indoorLightInfluence = northBlock ? northBlock->GetIndoorLightInfluence() : 0;
-			outdoorLightInfluence = northBlock ? northBlock->GetOutdoorLightInfluence() : 0;
-			break;
-		}
-		case Direction::SOUTH:
-		{
-			color = Rgba8(200, 200, 200, 255);
-			Block* southBlock = GetSouthBlock().GetBlock();
-			indoorLightInfluence = southBlock ? southBlock->GetIndoorLightInfluence() : 0;
-			outdoorLightInfluence = southBlock ? southBlock->GetOutdoorLightInfluence() : 0;
-			break;
-		}
-		case Direction::SKYWARD:
-		{
-			color = Rgba8::WHITE;
-			Block* skywardBlock = GetSkywardBlock().GetBlock();
-			indoorLightInfluence = skywardBlock ? skywardBlock->GetIndoorLightInfluence() : 0;
-			outdoorLightInfluence = skywardBlock ? skywardBlock->GetOutdoorLightInfluence() : 0;
-			break;
-		}
-		case Direction::GROUNDWARD:
-		{
-			color = Rgba8::WHITE;
-			Block* groundwardBlock = GetGroundwardBlock().GetBlock();
-			indoorLightInfluence = groundwardBlock ? groundwardBlock->GetIndoorLightInfluence() : 0;
-			outdoorLightInfluence = groundwardBlock ? groundwardBlock->GetOutdoorLightInfluence() : 0;
-			break;
-		}
+		return Rgba8(255, 255, 255, 255);
 	}
 
-	unsigned char red = GetBlock()->IsWater() ? 255 : (unsigned char)RangeMapClamped((float)outdoorLightInfluence, 0.f, (float)OUTDOOR_LIGHTING_BITMASK, 0.f, (float)color.r);
-	unsigned char green = GetBlock()->IsWater() ? 255 : (unsigned char)RangeMapClamped((float)indoorLightInfluence, 0.f, (float)INDOOR_LIGHTING_BITMASK, 0.f, (float)color.g);
-	unsigned char blue = GetBlock()->IsWater() ? 255 : 0;
+	int indoorLightInfluence = neighborBlockIter.IsValid() ? neighborBlockIter.GetIndoorLightInfluence() : 0;
+	int outdoorLightInfluence = neighborBlockIter.IsValid() ? neighborBlockIter.GetOutdoorLightInfluence() : 0;
+
+	unsigned char red = (unsigned char)RangeMapClamped((float)outdoorLightInfluence, 0.f, (float)OUTDOOR_LIGHTING_BITMASK, 0.f, (float)faceShade);
+	unsigned char green = (unsigned char)RangeMapClamped((float)indoorLightInfluence, 0.f, (float)INDOOR_LIGHTING_BITMASK, 0.f, (float)faceShade);
 
-	return Rgba8(red, green, blue, 255);
+	return Rgba8(red, green, 0, 255);
 }
+
+template Rgba8 BlockIter::GetFaceTintForLightInfluenceValues<Direction::EAST>(BlockIter const& neighborBlockIter) const;
+template Rgba8 BlockIter::GetFaceTintForLightInfluenceValues<Direction::WEST>(BlockIter const& neighborBlockIter) const;
+template Rgba8 BlockIter::GetFaceTintForLightInfluenceValues<Direction::NORTH>(BlockIter const& neighborBlockIter) const;
+template Rgba8 BlockIter::GetFaceTintForLightInfluenceValues<Direction::SOUTH>(BlockIter const& neighborBlockIter) const;
+template Rgba8 BlockIter::GetFaceTintForLightInfluenceValues<Direction::SKYWARD>(BlockIter const& neighborBlockIter) const;
+template Rgba8 BlockIter::GetFaceTintForLightInfluenceValues<Direction::GROUNDWARD>(BlockIter const& neighborBlockIter) const;
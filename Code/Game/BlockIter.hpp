@@ -1,12 +1,12 @@
 #pragma once
 
+#include "Game/Block.hpp"
 #include "Game/GameCommon.hpp"
 
 #include "Engine/Core/Rgba8.hpp"
 #include "Engine/Math/Vec3.hpp"
 
 class Chunk;
-struct Block;
 
 class BlockIter
 {
@@ -15,7 +15,16 @@ public:
 	BlockIter() = default;
 	BlockIter(Chunk* chunk, int blockIndex);
 
-	Block* GetBlock() const;
+	bool IsValid() const;
+	BlockDefinitionID GetType() const;
+	bool IsVisible() const;
+	bool IsSolid() const;
+	bool IsOpaque() const;
+	bool IsWater() const;
+	int GetIndoorLightInfluence() const;
+	int GetOutdoorLightInfluence() const;
+	template <Direction direction>
+	BlockIter Step() const;
 	BlockIter GetEastBlock() const;
 	BlockIter GetWestBlock() const;
 	BlockIter GetNorthBlock() const;
@@ -24,7 +33,8 @@ public:
 	BlockIter GetGroundwardBlock() const;
 	Vec3 GetWorldCenter() const;
 
-	Rgba8 GetFaceTintForLightInfluenceValues(Direction direction) const;
+	template <Direction direction>
+	Rgba8 GetFaceTintForLightInfluenceValues(BlockIter const& neighborBlockIter) const;
 
 public:
 	Chunk* m_chunk = nullptr;
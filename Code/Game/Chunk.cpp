@@ -4,7 +4,9 @@
 #include "Game/Game.hpp"
 #include "Game/GameCommon.hpp"
 #include "Game/World.hpp"
+#include "Game/RegionFile.hpp"
 #include "Game/BlockIter.hpp"
+#include "Game/ChunkCodec.hpp"
 
 #include "Engine/Core/DevConsole.hpp"
 #include "Engine/Core/FileUtils.hpp"
@@ -14,6 +16,10 @@
 #include "ThirdParty/Squirrel/SmoothNoise.hpp"
 #include "ThirdParty/Squirrel/RawNoise.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <emmintrin.h>
+
 
 constexpr int SEA_LEVEL = 64;
 constexpr int RIVER_MAX_DEPTH = 5;
@@ -23,12 +29,6 @@ constexpr int MAX_OCEAN_DEPTH = 30;
 
 Chunk::~Chunk()
 {
-	if (m_needsSaving)
-	{
-		m_state = ChunkState::DEACTIVATING_SAVING;
-		SaveToFile();
-	}
-
 	if (m_eastNeighbor)
 	{
 		m_eastNeighbor->m_westNeighbor = nullptr;
@@ -50,6 +50,8 @@ Chunk::~Chunk()
 	m_vertexBuffer = nullptr;
 	delete m_blocks;
 	m_blocks = nullptr;
+	delete m_compressedBlocks;
+	m_compressedBlocks = nullptr;
 
 	m_state = ChunkState::DEACTIVATING_SAVE_COMPLETE;
 }
@@ -59,41 +61,76 @@ Chunk::Chunk(World* world, IntVec2 const& chunkCoords)
 	, m_coords(chunkCoords)
 	, m_worldPosition((float)(chunkCoords.x * CHUNK_SIZE_X), float(chunkCoords.y * CHUNK_SIZE_Y), 0.f)
 	, m_worldBounds(m_worldPosition, m_worldPosition + Vec3::EAST * CHUNK_SIZE_X + Vec3::NORTH * CHUNK_SIZE_Y + Vec3::SKYWARD * CHUNK_SIZE_Z)
+	, m_dirtyLightingQueue(CHUNK_LIGHTING_QUEUE_INITIAL_CAPACITY)
+	, m_lightRemovalQueue(CHUNK_LIGHTING_QUEUE_INITIAL_CAPACITY)
 {
-	m_blocks = new Block[CHUNK_BLOCKS_TOTAL];
+	m_blocks = new ChunkBlocks();
 }
 
 bool Chunk::LoadFromFile()
 {
 	m_state = ChunkState::ACTIVATING_LOADING;
 
-	std::string chunkFilePath = m_world->GetSaveFilePath() + Stringf("/Chunk(%i,%i).chunk", m_coords.x, m_coords.y);
-	std::vector<uint8_t> chunkFileContents;
-	int numBytesRead = FileReadToBuffer(chunkFileContents, chunkFilePath);
+	// A chunk reactivated before its save reaches the disk takes its blocks from the newest snapshot, without encoding or decoding them
+	std::shared_ptr<ChunkSaveSnapshot const> saveSnapshot = m_world->FindChunkSaveSnapshot(m_coords);
+	if (saveSnapshot)
+	{
+		LoadFromSnapshot(*saveSnapshot);
+		return true;
+	}
 
-	if (numBytesRead < 8)
+	std::vector<uint8_t> chunkFileContents;
+	if (!m_world->ReadChunkData(m_coords, chunkFileContents))
 	{
 		return false;
 	}
 
-	GUARANTEE_OR_DIE(chunkFileContents[0] == 'G', Stringf("Invalid chunk file provided for chunk(%d, %d)", m_coords.x, m_coords.y));
-	GUARANTEE_OR_DIE(chunkFileContents[1] == 'C', Stringf("Invalid chunk file provided for chunk(%d, %d)", m_coords.x, m_coords.y));
-	GUARANTEE_OR_DIE(chunkFileContents[2] == 'H', Stringf("Invalid chunk file provided for chunk(%d, %d)", m_coords.x, m_coords.y));
-	GUARANTEE_OR_DIE(chunkFileContents[3] == 'K', Stringf("Invalid chunk file provided for chunk(%d, %d)", m_coords.x, m_coords.y));
+	return LoadFromBuffer(chunkFileContents.data(), chunkFileContents.size());
+}
+
+void Chunk::LoadFromSnapshot(ChunkSaveSnapshot const& snapshot)
+{
+	ChunkBlocks const& snapshotBlocks = *snapshot.m_blocks;
+	memcpy(m_blocks->m_types, snapshotBlocks.m_types, sizeof(m_blocks->m_types));
+	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+	{
+		m_blocks->m_flags[blockIndex] = BlockDefinition::s_blockProperties[m_blocks->m_types[blockIndex]].m_flags;
+	}
+
+	m_numEditedBlocks = snapshot.m_numEditedBlocks;
+
+	// Light is only carried over when it had settled, exactly as if the snapshot had been saved and loaded again
+	m_hasSavedLighting = snapshot.m_saveLighting;
+	if (m_hasSavedLighting)
+	{
+		memcpy(m_blocks->m_lightInfluences, snapshotBlocks.m_lightInfluences, sizeof(m_blocks->m_lightInfluences));
+	}
+
+	m_state = ChunkState::ACTIVATING_LOAD_COMPLETE;
+}
+
+bool Chunk::LoadFromBuffer(uint8_t const* chunkFileData, size_t chunkFileSize)
+{
+	// Corrupt or truncated files are rejected rather than trusted, so the chunk is generated again instead of crashing the loader
+	if (chunkFileSize < CHUNK_FILE_HEADER_SIZE || chunkFileData[0] != 'G' || chunkFileData[1] != 'C' || chunkFileData[2] != 'H' || chunkFileData[3] != 'K')
+	{
+		g_console->AddLine(Stringf("Invalid chunk file provided for chunk (%d, %d). File will be ignored!", m_coords.x, m_coords.y));
+		return false;
+	}
 
-	int chunkFileVersion = chunkFileContents[4];
-	int fileChunkBitsX = chunkFileContents[5];
-	int fileChunkBitsY = chunkFileContents[6];
-	int fileChunkBitsZ = chunkFileContents[7];
+	int chunkFileVersion = chunkFileData[4];
+	int fileChunkBitsX = chunkFileData[5];
+	int fileChunkBitsY = chunkFileData[6];
+	int fileChunkBitsZ = chunkFileData[7];
 
-	uint8_t worldSeed0 = chunkFileContents[8];
-	uint8_t worldSeed1 = chunkFileContents[9];
-	uint8_t worldSeed2 = chunkFileContents[10];
-	uint8_t worldSeed3 = chunkFileContents[11];
+	uint8_t worldSeed0 = chunkFileData[8];
+	uint8_t worldSeed1 = chunkFileData[9];
+	uint8_t worldSeed2 = chunkFileData[10];
+	uint8_t worldSeed3 = chunkFileData[11];
 
 	int worldSeedInChunkFile = (int)(worldSeed0 | (worldSeed1 << 8) | (worldSeed2 << 16) | (worldSeed3 << 24));
 
-	if (chunkFileVersion != m_world->GetChunkFileVersion())
+	if (chunkFileVersion != CHUNK_FILE_VERSION_BLOCKS && chunkFileVersion != CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING && chunkFileVersion != CHUNK_FILE_VERSION_EDIT_DELTA && chunkFileVersion != CHUNK_FILE_VERSION_PACKED)
 	{
 		g_console->AddLine(Stringf("Version mismatch for chunk file (%d, %d). File will be ignored!", m_coords.x, m_coords.y));
 		return false;
@@ -111,53 +148,251 @@ bool Chunk::LoadFromFile()
 		return false;
 	}
 
-	int currentBlockIndex = 0;
-	for (int chunkFileContentIndex = 12; chunkFileContentIndex < (int)chunkFileContents.size(); chunkFileContentIndex += 2)
+	if (chunkFileVersion == CHUNK_FILE_VERSION_EDIT_DELTA)
+	{
+		return LoadEditDeltaFromBuffer(chunkFileData, chunkFileSize);
+	}
+
+	// A full file does not say how far the chunk is from the generator's output, so it is not diffed against it again
+	m_numEditedBlocks = CHUNK_BLOCKS_TOTAL;
+
+	if (chunkFileVersion == CHUNK_FILE_VERSION_PACKED)
+	{
+		return LoadPackedFromBuffer(chunkFileData, chunkFileSize);
+	}
+
+	// The chunk is not visible to anything else yet, so runs are filled straight into its arrays and uniformity is computed afterwards
+	size_t chunkFileReadIndex = CHUNK_FILE_HEADER_SIZE;
+	if (!DecodeChunkFileRuns(chunkFileData, chunkFileSize, chunkFileReadIndex, m_blocks->m_types, m_blocks->m_flags))
+	{
+		g_console->AddLine(Stringf("Block runs in chunk file (%d, %d) are truncated or overflow the chunk. File will be ignored!", m_coords.x, m_coords.y));
+		return false;
+	}
+
+	// Newer files also carry the light values the chunk had settled on, RLE'd separately from the block types
+	m_hasSavedLighting = false;
+	if (chunkFileVersion == CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING)
+	{
+		if (!DecodeChunkFileRuns(chunkFileData, chunkFileSize, chunkFileReadIndex, m_blocks->m_lightInfluences, nullptr))
+		{
+			g_console->AddLine(Stringf("Light runs in chunk file (%d, %d) are truncated or overflow the chunk. File will be ignored!", m_coords.x, m_coords.y));
+			return false;
+		}
+		m_hasSavedLighting = true;
+	}
+
+	m_state = ChunkState::ACTIVATING_LOAD_COMPLETE;
+	return true;
+}
+
+void Chunk::DiscardLoadedBlocks()
+{
+	// A failed load may have written part of any channel and claimed saved light, none of which the generator overwrites
+	memset(m_blocks->m_types, 0, sizeof(m_blocks->m_types));
+	memset(m_blocks->m_lightInfluences, 0, sizeof(m_blocks->m_lightInfluences));
+	memset(m_blocks->m_flags, 0, sizeof(m_blocks->m_flags));
+	m_uniformSections = 0;
+	m_emitterBlockIndexes.clear();
+	m_hasSavedLighting = false;
+	m_numEditedBlocks = 0;
+}
+
+bool Chunk::DecodeChunkFileRuns(uint8_t const* chunkFileData, size_t chunkFileSize, size_t& chunkFileReadIndex, uint8_t* out_values, uint8_t* out_flags)
+{
+	int blockIndex = 0;
+	while (blockIndex < CHUNK_BLOCKS_TOTAL)
+	{
+		if (chunkFileReadIndex + 2 > chunkFileSize)
+		{
+			return false;
+		}
+
+		uint8_t value = chunkFileData[chunkFileReadIndex];
+		int numBlocks = chunkFileData[chunkFileReadIndex + 1];
+		chunkFileReadIndex += 2;
+		if (numBlocks > CHUNK_BLOCKS_TOTAL - blockIndex)
+		{
+			return false;
+		}
+
+		// Types also fill in their flags, looked up once per run instead of once per block
+		memset(&out_values[blockIndex], value, numBlocks);
+		if (out_flags)
+		{
+			if (value >= (int)BlockDefinition::s_blockDefs.size())
+			{
+				return false;
+			}
+			memset(&out_flags[blockIndex], BlockDefinition::s_blockProperties[value].m_flags, numBlocks);
+		}
+		blockIndex += numBlocks;
+	}
+
+	return true;
+}
+
+bool Chunk::LoadPackedFromBuffer(uint8_t const* chunkFileData, size_t chunkFileSize)
+{
+	if (!DecodePackedChunkFileBody(chunkFileData + CHUNK_FILE_HEADER_SIZE, chunkFileSize - CHUNK_FILE_HEADER_SIZE, m_blocks->m_types, m_blocks->m_lightInfluences, m_hasSavedLighting))
+	{
+		g_console->AddLine(Stringf("Packed chunk file (%d, %d) is truncated or corrupt. File will be ignored!", m_coords.x, m_coords.y));
+		return false;
+	}
+
+	int numBlockDefs = (int)BlockDefinition::s_blockDefs.size();
+	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+	{
+		BlockDefinitionID blockType = m_blocks->m_types[blockIndex];
+		if (blockType >= numBlockDefs)
+		{
+			g_console->AddLine(Stringf("Packed chunk file (%d, %d) has undefined block type %d. File will be ignored!", m_coords.x, m_coords.y, (int)blockType));
+			return false;
+		}
+		m_blocks->m_flags[blockIndex] = BlockDefinition::s_blockProperties[blockType].m_flags;
+	}
+
+	m_state = ChunkState::ACTIVATING_LOAD_COMPLETE;
+	return true;
+}
+
+bool Chunk::LoadEditDeltaFromBuffer(uint8_t const* chunkFileData, size_t chunkFileSize)
+{
+	// The edits are applied on top of a freshly generated copy of the chunk; light is not stored, so the chunk is always relit
+	if (chunkFileSize < CHUNK_FILE_HEADER_SIZE + 2)
+	{
+		g_console->AddLine(Stringf("Chunk file for chunk (%d, %d) is missing its edit count. File will be ignored!", m_coords.x, m_coords.y));
+		return false;
+	}
+
+	int numEditedBlocks = chunkFileData[CHUNK_FILE_HEADER_SIZE] | (chunkFileData[CHUNK_FILE_HEADER_SIZE + 1] << 8);
+	if (chunkFileSize != (size_t)(CHUNK_FILE_HEADER_SIZE + 2 + numEditedBlocks * 3))
 	{
-		uint8_t blockType = chunkFileContents[chunkFileContentIndex];
-		int numBlocks = chunkFileContents[chunkFileContentIndex + 1];
+		g_console->AddLine(Stringf("Chunk file for chunk (%d, %d) has %d edits but %d bytes. File will be ignored!", m_coords.x, m_coords.y, numEditedBlocks, (int)chunkFileSize));
+		return false;
+	}
+
+	GenerateChunkBlocks();
 
-		while (numBlocks--)
+	for (int editIndex = 0; editIndex < numEditedBlocks; editIndex++)
+	{
+		uint8_t const* edit = &chunkFileData[CHUNK_FILE_HEADER_SIZE + 2 + editIndex * 3];
+		int blockIndex = edit[0] | (edit[1] << 8);
+		if (blockIndex >= CHUNK_BLOCKS_TOTAL || edit[2] >= (int)BlockDefinition::s_blockDefs.size())
 		{
-			m_blocks[currentBlockIndex] = Block(blockType);
-			currentBlockIndex++;
+			g_console->AddLine(Stringf("Chunk file for chunk (%d, %d) has an invalid edit of block %d. File will be ignored!", m_coords.x, m_coords.y, blockIndex));
+			return false;
 		}
+
+		SetBlockTypeID(blockIndex, edit[2]);
 	}
 
+	m_numEditedBlocks = numEditedBlocks;
+	m_hasSavedLighting = false;
 	m_state = ChunkState::ACTIVATING_LOAD_COMPLETE;
 	return true;
 }
 
-bool Chunk::SaveToFile() const
+ChunkSaveSnapshot* Chunk::TakeSaveSnapshot()
+{
+	// The chunk is about to be destroyed, so its blocks are handed over instead of copied
+	ExpandBlocks();
+
+	ChunkSaveSnapshot* snapshot = new ChunkSaveSnapshot();
+	snapshot->m_coords = m_coords;
+	snapshot->m_blocks.reset(m_blocks);
+	m_blocks = nullptr;
+
+	// Light is only worth saving once it has settled; otherwise the chunk is relit from scratch when it is loaded again
+	snapshot->m_chunkFileVersion = m_world->GetChunkFileVersion();
+	snapshot->m_saveLighting = m_world->m_saveChunkLighting && !HasDirtyLighting();
+	if (snapshot->m_chunkFileVersion == CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING && !snapshot->m_saveLighting)
+	{
+		snapshot->m_chunkFileVersion = CHUNK_FILE_VERSION_BLOCKS;
+	}
+	snapshot->m_maxEditDeltaBlocks = m_world->m_maxEditDeltaBlocks;
+	snapshot->m_numEditedBlocks = m_numEditedBlocks;
+
+	m_needsSaving = false;
+	return snapshot;
+}
+
+void Chunk::WriteChunkFileBuffer(ChunkSaveSnapshot const& snapshot, World* world, std::vector<uint8_t>& fileBuffer)
 {
-	uint8_t currentBlockType = m_blocks[0].m_type;
-	std::vector<uint8_t> fileBuffer;
+	ChunkBlocks const& blocks = *snapshot.m_blocks;
+	int chunkFileVersion = snapshot.m_chunkFileVersion;
+	int worldSeed = world->m_worldSeed;
+
+	// Generation is deterministic, so a lightly edited chunk only needs the blocks that differ from a freshly generated copy
+	// Chunks with more edits than the threshold fall back to the full format, which is smaller for them and keeps their light
+	// Only the block types are regenerated, and not at all for chunks that have been edited more often than the threshold
+	std::vector<uint16_t> editedBlockIndexes;
+	if (snapshot.m_maxEditDeltaBlocks > 0 && snapshot.m_numEditedBlocks <= snapshot.m_maxEditDeltaBlocks)
+	{
+		BlockDefinitionID generatedBlockTypes[CHUNK_BLOCKS_TOTAL];
+		GenerateChunkBlockTypes(world, snapshot.m_coords, generatedBlockTypes);
+
+		for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL && (int)editedBlockIndexes.size() <= snapshot.m_maxEditDeltaBlocks; blockIndex++)
+		{
+			if (blocks.m_types[blockIndex] != generatedBlockTypes[blockIndex])
+			{
+				editedBlockIndexes.push_back((uint16_t)blockIndex);
+			}
+		}
+
+		if ((int)editedBlockIndexes.size() <= snapshot.m_maxEditDeltaBlocks)
+		{
+			chunkFileVersion = CHUNK_FILE_VERSION_EDIT_DELTA;
+		}
+	}
+
+	uint8_t currentBlockType = blocks.m_types[0];
 
 	fileBuffer.push_back('G');
 	fileBuffer.push_back('C');
 	fileBuffer.push_back('H');
 	fileBuffer.push_back('K');
-	fileBuffer.push_back((uint8_t)m_world->GetChunkFileVersion());
+	fileBuffer.push_back((uint8_t)chunkFileVersion);
 	fileBuffer.push_back((uint8_t)CHUNK_XBITS);
 	fileBuffer.push_back((uint8_t)CHUNK_YBITS);
 	fileBuffer.push_back((uint8_t)CHUNK_ZBITS);
 
-	fileBuffer.push_back((uint8_t)(m_world->m_worldSeed));
-	fileBuffer.push_back((uint8_t)(m_world->m_worldSeed >> 8));
-	fileBuffer.push_back((uint8_t)(m_world->m_worldSeed >> 16));
-	fileBuffer.push_back((uint8_t)(m_world->m_worldSeed >> 24));
+	fileBuffer.push_back((uint8_t)(worldSeed));
+	fileBuffer.push_back((uint8_t)(worldSeed >> 8));
+	fileBuffer.push_back((uint8_t)(worldSeed >> 16));
+	fileBuffer.push_back((uint8_t)(worldSeed >> 24));
+
+	if (chunkFileVersion == CHUNK_FILE_VERSION_PACKED)
+	{
+		EncodePackedChunkFileBody(blocks.m_types, snapshot.m_saveLighting ? blocks.m_lightInfluences : nullptr, fileBuffer);
+		return;
+	}
+
+	if (chunkFileVersion == CHUNK_FILE_VERSION_EDIT_DELTA)
+	{
+		int numEditedBlocks = (int)editedBlockIndexes.size();
+		fileBuffer.push_back((uint8_t)(numEditedBlocks));
+		fileBuffer.push_back((uint8_t)(numEditedBlocks >> 8));
+		for (int editIndex = 0; editIndex < numEditedBlocks; editIndex++)
+		{
+			uint16_t blockIndex = editedBlockIndexes[editIndex];
+			fileBuffer.push_back((uint8_t)(blockIndex));
+			fileBuffer.push_back((uint8_t)(blockIndex >> 8));
+			fileBuffer.push_back(blocks.m_types[blockIndex]);
+		}
+		return;
+	}
 
 	int numBlocksWritten = 0;
 	uint8_t currentNumBlocks = 1;
 	for (int blockIndex = 1; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
 	{
-		if (currentNumBlocks == UINT8_MAX || m_blocks[blockIndex].m_type != currentBlockType)
+		if (currentNumBlocks == UINT8_MAX || blocks.m_types[blockIndex] != currentBlockType)
 		{
 			fileBuffer.push_back(currentBlockType);
 			fileBuffer.push_back(currentNumBlocks);
 			numBlocksWritten += currentNumBlocks;
 			currentNumBlocks = 1;
-			currentBlockType = m_blocks[blockIndex].m_type;
+			currentBlockType = blocks.m_types[blockIndex];
 		}
 		else
 		{
@@ -170,13 +405,46 @@ bool Chunk::SaveToFile() const
 	numBlocksWritten += currentNumBlocks;
 	GUARANTEE_OR_DIE(numBlocksWritten == CHUNK_BLOCKS_TOTAL, "Could not write all blocks to file");
 
-	std::string fileName = m_world->GetSaveFilePath() + Stringf("Chunk(%d,%d).chunk", m_coords.x, m_coords.y);
-	FileWriteBuffer(fileName, fileBuffer);
+	if (chunkFileVersion == CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING)
+	{
+		uint8_t currentLightInfluence = blocks.m_lightInfluences[0];
+		int numLightValuesWritten = 0;
+		uint8_t currentNumLightValues = 1;
+		for (int blockIndex = 1; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+		{
+			if (currentNumLightValues == UINT8_MAX || blocks.m_lightInfluences[blockIndex] != currentLightInfluence)
+			{
+				fileBuffer.push_back(currentLightInfluence);
+				fileBuffer.push_back(currentNumLightValues);
+				numLightValuesWritten += currentNumLightValues;
+				currentNumLightValues = 1;
+				currentLightInfluence = blocks.m_lightInfluences[blockIndex];
+			}
+			else
+			{
+				currentNumLightValues++;
+			}
+		}
+		fileBuffer.push_back(currentLightInfluence);
+		fileBuffer.push_back(currentNumLightValues);
 
-	return true;
+		numLightValuesWritten += currentNumLightValues;
+		GUARANTEE_OR_DIE(numLightValuesWritten == CHUNK_BLOCKS_TOTAL, "Could not write all light values to file");
+	}
 }
 
 void Chunk::GenerateChunkBlocks()
+{
+	// Types are generated straight into the chunk's array; flags and uniformity are derived from them afterwards
+	GenerateChunkBlockTypes(m_world, m_coords, m_blocks->m_types);
+	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+	{
+		m_blocks->m_flags[blockIndex] = BlockDefinition::s_blockProperties[m_blocks->m_types[blockIndex]].m_flags;
+	}
+	m_uniformSections = 0;
+}
+
+void Chunk::GenerateChunkBlockTypes(World const* world, IntVec2 const& chunkCoords, BlockDefinitionID* out_blockTypes)
 {
 	constexpr int CHUNK_COLUMNS_GRIDSIZEX = CHUNK_SIZE_X + CHUNK_GENERATION_NEIGHBORHOOD_OFFSET * 2;
 	constexpr int CHUNK_COLUMNS_GRIDSIZEY = CHUNK_SIZE_Y + CHUNK_GENERATION_NEIGHBORHOOD_OFFSET * 2;
@@ -189,7 +457,9 @@ void Chunk::GenerateChunkBlocks()
 	float forestness[NEIGHBORHOOD_ARRAYSIZE] = {};
 	float treeRawNoise[NEIGHBORHOOD_ARRAYSIZE] = {};
 
-	int worldSeed = m_world->m_worldSeed;
+	int worldSeed = world->m_worldSeed;
+	IntVec3 chunkOrigin(chunkCoords.x * CHUNK_SIZE_X, chunkCoords.y * CHUNK_SIZE_Y, 0);
+	std::vector<BlockTemplateToDo> blockTemplates;
 
 	int terrainHeightSeed = worldSeed + 1;
 	int humiditySeed = worldSeed + 2;
@@ -206,8 +476,8 @@ void Chunk::GenerateChunkBlocks()
 			int localX = neighborhoodX - CHUNK_GENERATION_NEIGHBORHOOD_OFFSET;
 			int localY = neighborhoodY - CHUNK_GENERATION_NEIGHBORHOOD_OFFSET;
 
-			int globalX = (int)m_worldPosition.x + localX;
-			int globalY = (int)m_worldPosition.y + localY;
+			int globalX = chunkOrigin.x + localX;
+			int globalY = chunkOrigin.y + localY;
 			float fGlobalX = (float)globalX;
 			float fGlobalY = (float)globalY;
 
@@ -250,7 +520,7 @@ void Chunk::GenerateChunkBlocks()
 			for (int neighborhoodX = 0; neighborhoodX < CHUNK_COLUMNS_GRIDSIZEX; neighborhoodX++)
 			{
 				IntVec3 neighborhoodColCoords(neighborhoodX, neighborhoodY, blockZ);
-				unsigned char blockType = ComputeBlockTypeAtIndex(neighborhoodColCoords, terrainHeights, humidity, temperature, forestness, treeRawNoise);
+				unsigned char blockType = ComputeBlockTypeAtIndex(worldSeed, chunkOrigin, neighborhoodColCoords, terrainHeights, humidity, temperature, forestness, treeRawNoise, blockTemplates);
 
 				int localX = neighborhoodX - CHUNK_GENERATION_NEIGHBORHOOD_OFFSET;
 				int localY = neighborhoodY - CHUNK_GENERATION_NEIGHBORHOOD_OFFSET;
@@ -258,32 +528,26 @@ void Chunk::GenerateChunkBlocks()
 
 				if (AreBlockCoordsInChunk(localCoords))
 				{
-					int blockIndex = GetBlockIndexFromCoords(localCoords);
-					m_blocks[blockIndex] = Block(blockType);
+					out_blockTypes[GetBlockIndexFromCoords(localCoords)] = blockType;
 				}
 			}
 		}
 	}
-}
 
-void Chunk::PlaceBlockTemplates()
-{
-	for (int blockTemplateIdx = 0; blockTemplateIdx < (int)m_blockTemplateSpawnToDo.size(); blockTemplateIdx++)
+	// Templates rooted in the neighborhood around the chunk are placed over the terrain, clipped to the chunk
+	for (int blockTemplateIdx = 0; blockTemplateIdx < (int)blockTemplates.size(); blockTemplateIdx++)
 	{
-		//BlockTemplateToDo const& blockTemplate = m_blockTemplateSpawnToDo[blockTemplateIdx];
-		IntVec3 const& root = m_blockTemplateSpawnToDo[blockTemplateIdx].m_root;
-		BlockTemplate const* blockTemplate = m_blockTemplateSpawnToDo[blockTemplateIdx].m_blockTemplate;
+		IntVec3 const& root = blockTemplates[blockTemplateIdx].m_root;
+		BlockTemplate const* blockTemplate = blockTemplates[blockTemplateIdx].m_blockTemplate;
 		for (int blockIndex = 0; blockIndex < (int)blockTemplate->m_blockTemplateEntries.size(); blockIndex++)
 		{
 			IntVec3 blockCoords = root + blockTemplate->m_blockTemplateEntries[blockIndex].m_offset;
 			if (AreBlockCoordsInChunk(blockCoords))
 			{
-				m_blocks[GetBlockIndexFromCoords(blockCoords)].SetTypeID(blockTemplate->m_blockTemplateEntries[blockIndex].m_blockType);
+				out_blockTypes[GetBlockIndexFromCoords(blockCoords)] = blockTemplate->m_blockTemplateEntries[blockIndex].m_blockType;
 			}
 		}
 	}
-
-	m_blockTemplateSpawnToDo.clear();
 }
 
 extern double g_chunkMeshRebuildTime;
@@ -291,41 +555,158 @@ extern int g_numChunkMeshesRebuilt;
 extern double g_blockVertexesAddingTime;
 void Chunk::RebuildMesh()
 {
-	if (!m_blocks)
-	{
-		return;
-	}
+	// Faces on the chunk border read the neighboring blocks
+	ExpandBlocksWithNeighbors();
 
 	double meshRebuildStartTime = GetCurrentTimeSeconds();
 	g_numChunkMeshesRebuilt++;
 
-	m_vertexes.clear();
-	m_vertexes.reserve(CHUNK_BLOCKS_PER_LAYER * 6);
-	m_chunkRenderedVerts = 0;
-
 	double blockVertexesAddingStartTime = GetCurrentTimeSeconds();
-	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+	BuildMeshVertexes();
+	double blockVertexesAddingEndTime = GetCurrentTimeSeconds();
+	g_blockVertexesAddingTime = (blockVertexesAddingEndTime - blockVertexesAddingStartTime) * 1000.f;
+
+	UploadMesh();
+
+	double meshRebuildEndTime = GetCurrentTimeSeconds();
+	g_chunkMeshRebuildTime = (meshRebuildEndTime - meshRebuildStartTime) * 1000.f;
+}
+
+void Chunk::BuildMeshVertexes()
+{
+	// Only dirty sections have their faces rebuilt; the vertexes of clean sections are copied over as they are
+	std::vector<Vertex_PCU> vertexes;
+	vertexes.reserve(GetMax((int)m_vertexes.size(), CHUNK_BLOCKS_PER_LAYER * 6));
+	int sectionVertexOffsets[CHUNK_NUM_SECTIONS + 1] = {};
+
+	for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
 	{
-		if (m_blocks[blockIndex].IsVisible())
+		sectionVertexOffsets[sectionIndex] = (int)vertexes.size();
+		if ((m_dirtyMeshSections & (1 << sectionIndex)) == 0)
+		{
+			vertexes.insert(vertexes.end(), m_vertexes.begin() + m_sectionVertexOffsets[sectionIndex], m_vertexes.begin() + m_sectionVertexOffsets[sectionIndex + 1]);
+			continue;
+		}
+
+		if (IsSectionUniform(sectionIndex))
+		{
+			uint8_t uniformFlags = BlockDefinition::s_blockProperties[m_sectionUniformTypes[sectionIndex]].m_flags;
+			if ((uniformFlags & VISIBLE_BITMASK) == 0)
+			{
+				continue;
+			}
+			if ((uniformFlags & WATER_BITMASK) == 0)
+			{
+				AddVertsForSectionShell(vertexes, sectionIndex);
+				continue;
+			}
+		}
+
+		// Flags are contiguous, so 16 blocks at a time can be checked for anything visible (most rows are air or buried)
+		__m128i const visibleBitmask = _mm_set1_epi8((char)VISIBLE_BITMASK);
+		int sectionStartBlockIndex = sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+		for (int rowStartIndex = sectionStartBlockIndex; rowStartIndex < sectionStartBlockIndex + CHUNK_BLOCKS_PER_SECTION; rowStartIndex += CHUNK_SIZE_X)
 		{
-			AddVertsForBlock(blockIndex);
+			__m128i rowFlags = _mm_load_si128((__m128i const*)&m_blocks->m_flags[rowStartIndex]);
+			int visibleMask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(rowFlags, visibleBitmask), visibleBitmask));
+			for (int x = 0; visibleMask != 0; x++, visibleMask >>= 1)
+			{
+				if (visibleMask & 1)
+				{
+					AddVertsForBlock(vertexes, rowStartIndex + x);
+				}
+			}
 		}
 	}
-	double blockVertexesAddingEndTime = GetCurrentTimeSeconds();
-	g_blockVertexesAddingTime = (blockVertexesAddingEndTime - blockVertexesAddingStartTime) * 1000.f;
+	sectionVertexOffsets[CHUNK_NUM_SECTIONS] = (int)vertexes.size();
+
+	m_vertexes.swap(vertexes);
+	for (int sectionIndex = 0; sectionIndex <= CHUNK_NUM_SECTIONS; sectionIndex++)
+	{
+		m_sectionVertexOffsets[sectionIndex] = sectionVertexOffsets[sectionIndex];
+	}
+	m_chunkRenderedVerts = (int)m_vertexes.size();
+
+	m_dirtyMeshSections = 0;
 
 	//AddVertsForAABB3(m_debugVertexes, m_worldBounds, Rgba8::MAGENTA);
+}
 
+void Chunk::UploadMesh()
+{
 	if (!m_vertexBuffer)
 	{
 		m_vertexBuffer = g_renderer->CreateVertexBuffer(m_vertexes.size() * sizeof(Vertex_PCU));
 	}
 
 	g_renderer->CopyCPUToGPU(m_vertexes.data(), m_vertexes.size() * sizeof(Vertex_PCU), m_vertexBuffer);
-	m_isCpuMeshDirty = false;
+}
 
-	double meshRebuildEndTime = GetCurrentTimeSeconds();
-	g_chunkMeshRebuildTime = (meshRebuildEndTime - meshRebuildStartTime) * 1000.f;
+void Chunk::AddVertsForSectionShell(std::vector<Vertex_PCU>& verts, int sectionIndex)
+{
+	// Every interior block of a uniform section is surrounded by the same visible block, so only the outer shell can have faces
+	int sectionStartBlockIndex = sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+	for (int sectionZ = 0; sectionZ < CHUNK_SECTION_SIZE_Z; sectionZ++)
+	{
+		for (int y = 0; y < CHUNK_SIZE_Y; y++)
+		{
+			int rowStartIndex = sectionStartBlockIndex | (sectionZ << (CHUNK_XBITS + CHUNK_YBITS)) | (y << CHUNK_XBITS);
+			bool isOuterRow = (sectionZ == 0) || (sectionZ == CHUNK_SECTION_SIZE_Z - 1) || (y == 0) || (y == CHUNK_SIZE_Y - 1);
+			if (isOuterRow)
+			{
+				for (int x = 0; x < CHUNK_SIZE_X; x++)
+				{
+					AddVertsForBlock(verts, rowStartIndex | x);
+				}
+			}
+			else
+			{
+				AddVertsForBlock(verts, rowStartIndex);
+				AddVertsForBlock(verts, rowStartIndex | (CHUNK_SIZE_X - 1));
+			}
+		}
+	}
+}
+
+void Chunk::InitializeSectionUniformity()
+{
+	m_uniformSections = 0;
+	for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
+	{
+		int sectionStartBlockIndex = sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+		BlockDefinitionID sectionType = m_blocks->m_types[sectionStartBlockIndex];
+		__m128i const sectionTypes = _mm_set1_epi8((char)sectionType);
+
+		bool isUniform = true;
+		for (int rowStartIndex = sectionStartBlockIndex; rowStartIndex < sectionStartBlockIndex + CHUNK_BLOCKS_PER_SECTION && isUniform; rowStartIndex += CHUNK_SIZE_X)
+		{
+			__m128i rowTypes = _mm_load_si128((__m128i const*)&m_blocks->m_types[rowStartIndex]);
+			isUniform = _mm_movemask_epi8(_mm_cmpeq_epi8(rowTypes, sectionTypes)) == 0xFFFF;
+		}
+
+		if (isUniform)
+		{
+			m_uniformSections |= (uint8_t)(1 << sectionIndex);
+			m_sectionUniformTypes[sectionIndex] = sectionType;
+		}
+	}
+}
+
+bool Chunk::IsSectionUniform(int sectionIndex) const
+{
+	return (m_uniformSections & (1 << sectionIndex)) != 0;
+}
+
+bool Chunk::IsBlockSolidInUniformSection(int blockIndex, bool& out_isSolid) const
+{
+	int sectionIndex = blockIndex / CHUNK_BLOCKS_PER_SECTION;
+	if (!IsSectionUniform(sectionIndex))
+	{
+		return false;
+	}
+
+	out_isSolid = (BlockDefinition::s_blockProperties[m_sectionUniformTypes[sectionIndex]].m_flags & SOLID_BITMASK) != 0;
+	return true;
 }
 
 void Chunk::Update()
@@ -375,17 +756,17 @@ IntVec3 Chunk::GetBlockCoordsFromIndex(int blockIndex) const
 	return IntVec3(x, y, z);
 }
 
-int Chunk::GetBlockIndexFromCoords(IntVec3 const& blockCoords) const
+int Chunk::GetBlockIndexFromCoords(IntVec3 const& blockCoords)
 {
 	return (blockCoords.x | (blockCoords.y << CHUNK_XBITS) | (blockCoords.z << (CHUNK_XBITS + CHUNK_YBITS)));
 }
 
-int Chunk::GetBlockIndexFromCoords(int blockX, int blockY, int blockZ) const
+int Chunk::GetBlockIndexFromCoords(int blockX, int blockY, int blockZ)
 {
 	return (blockX | (blockY << CHUNK_XBITS) | (blockZ << (CHUNK_XBITS + CHUNK_YBITS)));;
 }
 
-unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int terrainHeights[], float humidityArr[], float temperatureArr[], float forestness[], float treeRawNoise[])
+unsigned char Chunk::ComputeBlockTypeAtIndex(int worldSeed, IntVec3 const& chunkOrigin, IntVec3 const& neighborCoords, int terrainHeights[], float humidityArr[], float temperatureArr[], float forestness[], float treeRawNoise[], std::vector<BlockTemplateToDo>& out_blockTemplates)
 {
 	static BlockDefinitionID airBlockID = BlockDefinition::GetBlockIDByName("air");
 	static BlockDefinitionID waterBlockID = BlockDefinition::GetBlockIDByName("water");
@@ -409,7 +790,14 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 
 	IntVec3 localCoords = neighborCoords - IntVec3(CHUNK_GENERATION_NEIGHBORHOOD_OFFSET, CHUNK_GENERATION_NEIGHBORHOOD_OFFSET, 0);
 	int terrainHeight = terrainHeights[neighborhoodColumnIndex];
-	IntVec3 globalCoords = localCoords + IntVec3(int(m_worldPosition.x), int(m_worldPosition.y), int(m_worldPosition.z));
+	IntVec3 globalCoords = localCoords + chunkOrigin;
+
+	// Rolls come from positional noise rather than g_RNG, so a chunk always generates the same blocks for a given seed
+	int dirtDepthSeed = worldSeed + 8;
+	int coalSeed = worldSeed + 9;
+	int ironSeed = worldSeed + 10;
+	int goldSeed = worldSeed + 11;
+	int diamondSeed = worldSeed + 12;
 
 	if (globalCoords.z == terrainHeight)
 	{
@@ -421,7 +809,7 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 	}
 	else if (globalCoords.z == terrainHeight - 4)
 	{
-		if (g_RNG->RollRandomChance(0.5f))
+		if (Get3dNoiseZeroToOne(globalCoords.x, globalCoords.y, globalCoords.z, dirtDepthSeed) < 0.5f)
 		{
 			blockType = dirtBlockID;
 		}
@@ -444,19 +832,19 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 	// randomly convert stone blocks to ores
 	if (blockType == stoneBlockID)
 	{
-		if (g_RNG->RollRandomChance(0.05f))
+		if (Get3dNoiseZeroToOne(globalCoords.x, globalCoords.y, globalCoords.z, coalSeed) < 0.05f)
 		{
 			blockType = coalBlockID;
 		}
-		else if (g_RNG->RollRandomChance(0.02f))
+		else if (Get3dNoiseZeroToOne(globalCoords.x, globalCoords.y, globalCoords.z, ironSeed) < 0.02f)
 		{
 			blockType = ironBlockID;
 		}
-		else if (g_RNG->RollRandomChance(0.005f))
+		else if (Get3dNoiseZeroToOne(globalCoords.x, globalCoords.y, globalCoords.z, goldSeed) < 0.005f)
 		{
 			blockType = goldBlockID;
 		}
-		else if (g_RNG->RollRandomChance(0.001f))
+		else if (Get3dNoiseZeroToOne(globalCoords.x, globalCoords.y, globalCoords.z, diamondSeed) < 0.001f)
 		{
 			blockType = diamondBlockID;
 		}
@@ -500,7 +888,7 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 				if (cactusTemplateIter != BlockTemplate::s_blockTemplates.end())
 				{
 					BlockTemplateToDo cactusTree(localCoords, &cactusTemplateIter->second);
-					m_blockTemplateSpawnToDo.push_back(cactusTree);
+					out_blockTemplates.push_back(cactusTree);
 				}
 			}
 			else if (temperature < 0.5f)
@@ -509,7 +897,7 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 				if (spruceTemplateIter != BlockTemplate::s_blockTemplates.end())
 				{
 					BlockTemplateToDo spruceTree(localCoords, &spruceTemplateIter->second);
-					m_blockTemplateSpawnToDo.push_back(spruceTree);
+					out_blockTemplates.push_back(spruceTree);
 				}
 			}
 			else
@@ -518,7 +906,7 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 				if (oakTemplateIter != BlockTemplate::s_blockTemplates.end())
 				{
 					BlockTemplateToDo oakTree(localCoords, &oakTemplateIter->second);
-					m_blockTemplateSpawnToDo.push_back(oakTree);
+					out_blockTemplates.push_back(oakTree);
 				}
 			}
 		}
@@ -527,7 +915,7 @@ unsigned char Chunk::ComputeBlockTypeAtIndex(IntVec3 const& neighborCoords, int
 	return blockType;
 }
 
-bool Chunk::IsLocalMaximum(IntVec2 const& neighborhoodColCoords, float rawNoise[], int range) const
+bool Chunk::IsLocalMaximum(IntVec2 const& neighborhoodColCoords, float rawNoise[], int range)
 {
 	constexpr int CHUNK_COLUMN_GRIDSIZEX = CHUNK_SIZE_X + (CHUNK_GENERATION_NEIGHBORHOOD_OFFSET * 2);
 	int neighborhoodColIndex = (neighborhoodColCoords.y * CHUNK_COLUMN_GRIDSIZEX) + neighborhoodColCoords.x;
@@ -553,26 +941,26 @@ bool Chunk::IsLocalMaximum(IntVec2 const& neighborhoodColCoords, float rawNoise[
 	return true;
 }
 
-void Chunk::AddVertsForBlock(int blockIndex)
+void Chunk::AddVertsForBlock(std::vector<Vertex_PCU>& verts, int blockIndex)
 {
 	IntVec3 blockCoords = GetBlockCoordsFromIndex(blockIndex);
 	BlockIter blockIter = BlockIter(this, blockIndex);
 
-	Block* southBlock = blockIter.GetSouthBlock().GetBlock();
-	Block* northBlock = blockIter.GetNorthBlock().GetBlock();
-	Block* eastBlock = blockIter.GetEastBlock().GetBlock();
-	Block* westBlock = blockIter.GetWestBlock().GetBlock();
-	Block* skywardBlock = blockIter.GetSkywardBlock().GetBlock();
-	Block* groundwardBlock = blockIter.GetGroundwardBlock().GetBlock();
-
-	bool addSouthFace = southBlock && !southBlock->IsVisible();
-	bool addNorthFace = northBlock && !northBlock->IsVisible();
-	bool addEastFace = eastBlock && !eastBlock->IsVisible();
-	bool addWestFace = westBlock && !westBlock->IsVisible();
-	bool addSkywardFace = skywardBlock && !skywardBlock->IsVisible();
-	bool addGroundwardFace = groundwardBlock && !groundwardBlock->IsVisible();
-
-	if (blockIter.GetBlock()->IsWater())
+	BlockIter southBlock = blockIter.Step<Direction::SOUTH>();
+	BlockIter northBlock = blockIter.Step<Direction::NORTH>();
+	BlockIter eastBlock = blockIter.Step<Direction::EAST>();
+	BlockIter westBlock = blockIter.Step<Direction::WEST>();
+	BlockIter skywardBlock = blockIter.Step<Direction::SKYWARD>();
+	BlockIter groundwardBlock = blockIter.Step<Direction::GROUNDWARD>();
+
+	bool addSouthFace = southBlock.IsValid() && !southBlock.IsVisible();
+	bool addNorthFace = northBlock.IsValid() && !northBlock.IsVisible();
+	bool addEastFace = eastBlock.IsValid() && !eastBlock.IsVisible();
+	bool addWestFace = westBlock.IsValid() && !westBlock.IsVisible();
+	bool addSkywardFace = skywardBlock.IsValid() && !skywardBlock.IsVisible();
+	bool addGroundwardFace = groundwardBlock.IsValid() && !groundwardBlock.IsVisible();
+
+	if (IsBlockWater(blockIndex))
 	{
 		addSouthFace = true;
 		addNorthFace = true;
@@ -583,9 +971,10 @@ void Chunk::AddVertsForBlock(int blockIndex)
 	}
 
 	blockCoords += IntVec3((int)m_worldPosition.x, (int)m_worldPosition.y, 0);
-	AABB2 const& topSpriteUVs = m_blocks[blockIndex].GetDefinition().m_topTextureUVs;
-	AABB2 const& sideSpriteUVs = m_blocks[blockIndex].GetDefinition().m_sideTextureUVs;
-	AABB2 const& bottomSpriteUVs = m_blocks[blockIndex].GetDefinition().m_bottomTextureUVs;
+	BlockProperties const& blockProperties = BlockDefinition::s_blockProperties[GetBlockType(blockIndex)];
+	AABB2 const& topSpriteUVs = BlockDefinition::s_spriteUVs[blockProperties.m_topSpriteIndex];
+	AABB2 const& sideSpriteUVs = BlockDefinition::s_spriteUVs[blockProperties.m_sideSpriteIndex];
+	AABB2 const& bottomSpriteUVs = BlockDefinition::s_spriteUVs[blockProperties.m_bottomSpriteIndex];
 
 	AABB3 blockBounds(blockCoords.GetAsVec3(), blockCoords.GetAsVec3() + Vec3::EAST + Vec3::NORTH + Vec3::SKYWARD);
 	Vec3 const& mins = blockBounds.m_mins;
@@ -602,44 +991,38 @@ void Chunk::AddVertsForBlock(int blockIndex)
 
 	if (addEastFace)
 	{
-		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues(Direction::EAST);
-		AddVertsForQuad3D(m_vertexes, BRB, BLB, TLB, TRB, tint, sideSpriteUVs); // +X
-		m_chunkRenderedVerts += 6;
+		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues<Direction::EAST>(eastBlock);
+		AddVertsForQuad3D(verts, BRB, BLB, TLB, TRB, tint, sideSpriteUVs); // +X
 	}
 
 	if (addWestFace)
 	{
-		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues(Direction::WEST);
-		AddVertsForQuad3D(m_vertexes, BLF, BRF, TRF, TLF, tint, sideSpriteUVs); // -X
-		m_chunkRenderedVerts += 6;
+		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues<Direction::WEST>(westBlock);
+		AddVertsForQuad3D(verts, BLF, BRF, TRF, TLF, tint, sideSpriteUVs); // -X
 	}
 
 	if (addNorthFace)
 	{
-		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues(Direction::NORTH);
-		AddVertsForQuad3D(m_vertexes, BLB, BLF, TLF, TLB, tint, sideSpriteUVs); // +Y
-		m_chunkRenderedVerts += 6;
+		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues<Direction::NORTH>(northBlock);
+		AddVertsForQuad3D(verts, BLB, BLF, TLF, TLB, tint, sideSpriteUVs); // +Y
 	}
 
 	if (addSouthFace)
 	{
-		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues(Direction::SOUTH);
-		AddVertsForQuad3D(m_vertexes, BRF, BRB, TRB, TRF, tint, sideSpriteUVs); // -Y
-		m_chunkRenderedVerts += 6;
+		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues<Direction::SOUTH>(southBlock);
+		AddVertsForQuad3D(verts, BRF, BRB, TRB, TRF, tint, sideSpriteUVs); // -Y
 	}
 
 	if (addSkywardFace)
 	{
-		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues(Direction::SKYWARD);
-		AddVertsForQuad3D(m_vertexes, TLF, TRF, TRB, TLB, tint, topSpriteUVs); // +Z
-		m_chunkRenderedVerts += 6;
+		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues<Direction::SKYWARD>(skywardBlock);
+		AddVertsForQuad3D(verts, TLF, TRF, TRB, TLB, tint, topSpriteUVs); // +Z
 	}
 
 	if (addGroundwardFace)
 	{
-		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues(Direction::GROUNDWARD);
-		AddVertsForQuad3D(m_vertexes, BLB, BRB, BRF, BLF, tint, bottomSpriteUVs); // -Z
-		m_chunkRenderedVerts += 6;
+		Rgba8 tint = blockIter.GetFaceTintForLightInfluenceValues<Direction::GROUNDWARD>(groundwardBlock);
+		AddVertsForQuad3D(verts, BLB, BRB, BRF, BLF, tint, bottomSpriteUVs); // -Z
 	}
 }
 
@@ -650,7 +1033,7 @@ IntVec3 Chunk::GetBlockCoordsFromWorldPosition(Vec3 const& worldPosition) const
 	return blockCoords;
 }
 
-bool Chunk::AreBlockCoordsInChunk(IntVec3 const& blockCoords) const
+bool Chunk::AreBlockCoordsInChunk(IntVec3 const& blockCoords)
 {
 	return (blockCoords.x >= 0 && blockCoords.x < CHUNK_SIZE_X && blockCoords.y >= 0 && blockCoords.y < CHUNK_SIZE_Y && blockCoords.z >= 0 && blockCoords.z < CHUNK_SIZE_Z);
 }
@@ -658,75 +1041,894 @@ bool Chunk::AreBlockCoordsInChunk(IntVec3 const& blockCoords) const
 bool Chunk::AddBlockAtWorldPosition(Vec3 const& worldPosition, BlockDefinitionID blockType)
 {
 	IntVec3 blockCoords = GetBlockCoordsFromWorldPosition(worldPosition);
-	int blockIndex = GetBlockIndexFromCoords(blockCoords);
-	m_blocks[blockIndex].SetTypeID(blockType);
-	BlockIter blockIter = BlockIter(this, blockIndex);
-	m_world->MarkBlockLightingDirty(blockIter);
-
-	if (m_blocks[blockIndex].IsSky() && m_blocks[blockIndex].IsOpaque())
-	{
-		m_blocks[blockIndex].SetSky(false);
-		blockIter = blockIter.GetGroundwardBlock();
-		Block* currentBlock = blockIter.GetBlock();
-		while (currentBlock && !currentBlock->IsOpaque())
-		{
-			currentBlock->SetSky(false);
-			m_world->MarkBlockLightingDirty(blockIter);
-
-			blockIter = blockIter.GetGroundwardBlock();
-			currentBlock = blockIter.GetBlock();
-		}
-	}
-
-	m_isCpuMeshDirty = true;
-	m_needsSaving = true;
+	SetBlockType(GetBlockIndexFromCoords(blockCoords), blockType);
 	return true;
 }
 
 bool Chunk::DigBlockAtWorldPosition(Vec3 const& worldPosition)
 {
-	BlockDefinitionID airBlockID = BlockDefinition::GetBlockIDByName("air");
+	static BlockDefinitionID airBlockID = BlockDefinition::GetBlockIDByName("air");
 
 	IntVec3 blockCoords = GetBlockCoordsFromWorldPosition(worldPosition);
-	int blockIndex = GetBlockIndexFromCoords(blockCoords);
-	m_blocks[blockIndex].SetTypeID(airBlockID);
-	BlockIter blockIter = BlockIter(this, blockIndex);
-	m_world->MarkBlockLightingDirty(blockIter);
+	SetBlockType(GetBlockIndexFromCoords(blockCoords), airBlockID);
+	return true;
+}
+
+void Chunk::SetBlockType(int blockIndex, BlockDefinitionID blockType)
+{
+	// Relighting the edited block reads its neighbors across chunk borders
+	ExpandBlocksWithNeighbors();
+
+	int columnIndex = blockIndex & (CHUNK_BLOCKS_PER_LAYER - 1);
+	int previousOpaqueHeight = m_opaqueHeights[columnIndex];
+	bool wasEmitter = BlockDefinition::s_blockProperties[GetBlockType(blockIndex)].m_lightInfluence != 0;
 
-	if (blockIter.GetSkywardBlock().GetBlock() && blockIter.GetSkywardBlock().GetBlock()->IsSky())
+	SetBlockTypeID(blockIndex, blockType);
+	UpdateHeightmapsForBlock(blockIndex);
+
+	bool isEmitter = BlockDefinition::s_blockProperties[blockType].m_lightInfluence != 0;
+	if (isEmitter && !wasEmitter)
+	{
+		m_emitterBlockIndexes.push_back((uint16_t)blockIndex);
+	}
+	else if (wasEmitter && !isEmitter)
 	{
-		m_blocks[blockIndex].SetSky(true);
-		blockIter = blockIter.GetGroundwardBlock();
-		Block* currentBlock = blockIter.GetBlock();
-		while (currentBlock && !currentBlock->IsOpaque())
+		auto emitterIter = std::find(m_emitterBlockIndexes.begin(), m_emitterBlockIndexes.end(), (uint16_t)blockIndex);
+		if (emitterIter != m_emitterBlockIndexes.end())
 		{
-			currentBlock->SetSky(true);
-			m_world->MarkBlockLightingDirty(blockIter);
+			m_emitterBlockIndexes.erase(emitterIter);
+		}
+	}
+	m_world->RelightBlock(BlockIter(this, blockIndex));
 
-			blockIter = blockIter.GetGroundwardBlock();
-			currentBlock = blockIter.GetBlock();
+	// Every block between the old and new opaque heights of the column either became sky or stopped being sky
+	int opaqueHeight = m_opaqueHeights[columnIndex];
+	int lowestSkyChangeZ = std::min(previousOpaqueHeight, opaqueHeight);
+	int highestSkyChangeZ = std::max(previousOpaqueHeight, opaqueHeight) - 1;
+	for (int z = highestSkyChangeZ; z >= lowestSkyChangeZ; z--)
+	{
+		int columnBlockIndex = columnIndex | (z << (CHUNK_XBITS + CHUNK_YBITS));
+		if (columnBlockIndex != blockIndex)
+		{
+			m_world->RelightBlock(BlockIter(this, columnBlockIndex));
 		}
 	}
 
-	m_isCpuMeshDirty = true;
+	// Faces of the edited block and of its neighbors may have appeared or disappeared
+	MarkMeshDirtyAroundBlock(blockIndex);
+	ApplyNeighborMeshDirtying();
 	m_needsSaving = true;
-	return true;
+	m_numEditedBlocks++;
 }
 
-bool Chunk::IsBlockOpaque(Block const* block) const
+void Chunk::MarkMeshDirtyAroundBlock(int blockIndex)
 {
-	if (!block)
+	// Faces are tinted by the light of the block they face, so a change shows up on the faces of the block's neighbors
+	// Neighbor chunks only need remeshing when the block is on their shared border; workers record those per side
+	// for the world to apply, since neighbors may be in use by other jobs
+	int x = blockIndex & CHUNK_BITMASK_X;
+	int y = (blockIndex >> CHUNK_XBITS) & CHUNK_BITMASK_Y;
+	int z = blockIndex >> (CHUNK_XBITS + CHUNK_YBITS);
+	int sectionIndex = z >> CHUNK_SECTION_ZBITS;
+	int zInSection = z & CHUNK_SECTION_BITMASK_Z;
+
+	uint8_t sectionMask = (uint8_t)(1 << sectionIndex);
+	m_dirtyMeshSections |= sectionMask;
+	if (zInSection == 0 && sectionIndex > 0)
 	{
-		return false;
+		m_dirtyMeshSections |= (uint8_t)(1 << (sectionIndex - 1));
+	}
+	if (zInSection == CHUNK_SECTION_BITMASK_Z && sectionIndex < CHUNK_NUM_SECTIONS - 1)
+	{
+		m_dirtyMeshSections |= (uint8_t)(1 << (sectionIndex + 1));
 	}
 
-	return block->IsOpaque();
-}
-
-void ChunkGenerateJob::Execute()
+	if (x == CHUNK_SIZE_X - 1)
+	{
+		m_neighborDirtyMeshSections[(int)Direction::EAST] |= sectionMask;
+	}
+	if (x == 0)
+	{
+		m_neighborDirtyMeshSections[(int)Direction::WEST] |= sectionMask;
+	}
+	if (y == CHUNK_SIZE_Y - 1)
+	{
+		m_neighborDirtyMeshSections[(int)Direction::NORTH] |= sectionMask;
+	}
+	if (y == 0)
+	{
+		m_neighborDirtyMeshSections[(int)Direction::SOUTH] |= sectionMask;
+	}
+}
+
+void Chunk::ApplyNeighborMeshDirtying()
+{
+	Chunk* neighborChunks[] = { m_eastNeighbor, m_westNeighbor, m_northNeighbor, m_southNeighbor };
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		if (neighborChunks[sideIndex])
+		{
+			neighborChunks[sideIndex]->m_dirtyMeshSections |= m_neighborDirtyMeshSections[sideIndex];
+		}
+		m_neighborDirtyMeshSections[sideIndex] = 0;
+	}
+}
+
+void Chunk::InitializeHeightmaps()
+{
+	for (int columnIndex = 0; columnIndex < CHUNK_BLOCKS_PER_LAYER; columnIndex++)
+	{
+		m_opaqueHeights[columnIndex] = (uint8_t)FindColumnHeight(columnIndex, CHUNK_SIZE_Z - 1, true);
+		m_surfaceHeights[columnIndex] = (uint8_t)FindColumnHeight(columnIndex, CHUNK_SIZE_Z - 1, false);
+	}
+}
+
+void Chunk::InitializeEmitters()
+{
+	// Emissive block types are rare, so later light seeding only visits the blocks found here
+	m_emitterBlockIndexes.clear();
+	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+	{
+		if (BlockDefinition::s_blockProperties[GetBlockType(blockIndex)].m_lightInfluence != 0)
+		{
+			m_emitterBlockIndexes.push_back((uint16_t)blockIndex);
+		}
+	}
+}
+
+void Chunk::UpdateHeightmapsForBlock(int blockIndex)
+{
+	static BlockDefinitionID airBlockID = BlockDefinition::GetBlockIDByName("air");
+
+	// Raising a column is O(1); only removing its top block needs a scan down to the next one
+	int columnIndex = blockIndex & (CHUNK_BLOCKS_PER_LAYER - 1);
+	int z = blockIndex >> (CHUNK_XBITS + CHUNK_YBITS);
+
+	if (IsBlockOpaque(blockIndex))
+	{
+		m_opaqueHeights[columnIndex] = (uint8_t)GetMax((int)m_opaqueHeights[columnIndex], z + 1);
+	}
+	else if (m_opaqueHeights[columnIndex] == z + 1)
+	{
+		m_opaqueHeights[columnIndex] = (uint8_t)FindColumnHeight(columnIndex, z - 1, true);
+	}
+
+	if (GetBlockType(blockIndex) != airBlockID)
+	{
+		m_surfaceHeights[columnIndex] = (uint8_t)GetMax((int)m_surfaceHeights[columnIndex], z + 1);
+	}
+	else if (m_surfaceHeights[columnIndex] == z + 1)
+	{
+		m_surfaceHeights[columnIndex] = (uint8_t)FindColumnHeight(columnIndex, z - 1, false);
+	}
+}
+
+int Chunk::FindColumnHeight(int columnIndex, int startZ, bool isOpaqueHeight) const
+{
+	static BlockDefinitionID airBlockID = BlockDefinition::GetBlockIDByName("air");
+
+	for (int z = startZ; z >= 0; z--)
+	{
+		int blockIndex = columnIndex | (z << (CHUNK_XBITS + CHUNK_YBITS));
+		bool isColumnTop = isOpaqueHeight ? IsBlockOpaque(blockIndex) : (GetBlockType(blockIndex) != airBlockID);
+		if (isColumnTop)
+		{
+			return z + 1;
+		}
+	}
+
+	return 0;
+}
+
+bool Chunk::IsBlockSky(int blockIndex) const
+{
+	int columnIndex = blockIndex & (CHUNK_BLOCKS_PER_LAYER - 1);
+	int z = blockIndex >> (CHUNK_XBITS + CHUNK_YBITS);
+	return z >= (int)m_opaqueHeights[columnIndex];
+}
+
+int Chunk::GetSurfaceHeight(int columnIndex) const
+{
+	return (int)m_surfaceHeights[columnIndex];
+}
+
+BlockDefinitionID Chunk::GetBlockType(int blockIndex) const
+{
+	return m_blocks->m_types[blockIndex];
+}
+
+void Chunk::SetBlockTypeID(int blockIndex, BlockDefinitionID blockType)
+{
+	int sectionIndex = blockIndex / CHUNK_BLOCKS_PER_SECTION;
+	if (IsSectionUniform(sectionIndex) && m_sectionUniformTypes[sectionIndex] != blockType)
+	{
+		m_uniformSections &= (uint8_t)~(1 << sectionIndex);
+	}
+
+	m_blocks->m_types[blockIndex] = blockType;
+	m_blocks->m_flags[blockIndex] = BlockDefinition::s_blockProperties[blockType].m_flags;
+}
+
+bool Chunk::IsBlockVisible(int blockIndex) const
+{
+	return (m_blocks->m_flags[blockIndex] & VISIBLE_BITMASK);
+}
+
+bool Chunk::IsBlockSolid(int blockIndex) const
+{
+	return (m_blocks->m_flags[blockIndex] & SOLID_BITMASK);
+}
+
+bool Chunk::IsBlockOpaque(int blockIndex) const
+{
+	return (m_blocks->m_flags[blockIndex] & OPAQUE_BITMASK);
+}
+
+bool Chunk::IsBlockWater(int blockIndex) const
+{
+	return (m_blocks->m_flags[blockIndex] & WATER_BITMASK);
+}
+
+int Chunk::GetBlockIndoorLightInfluence(int blockIndex) const
+{
+	return (m_blocks->m_lightInfluences[blockIndex] & INDOOR_LIGHTING_BITMASK);
+}
+
+int Chunk::GetBlockOutdoorLightInfluence(int blockIndex) const
+{
+	return (m_blocks->m_lightInfluences[blockIndex] >> INDOOR_LIGHTING_BITS) & OUTDOOR_LIGHTING_BITMASK;
+}
+
+int Chunk::GetBlockLightInfluence(int blockIndex, bool isOutdoor) const
+{
+	return isOutdoor ? GetBlockOutdoorLightInfluence(blockIndex) : GetBlockIndoorLightInfluence(blockIndex);
+}
+
+void Chunk::SetBlockIndoorLightInfluence(int blockIndex, int indoorLightInfluence)
+{
+	uint8_t& lightInfluence = m_blocks->m_lightInfluences[blockIndex];
+	lightInfluence &= ~INDOOR_LIGHTING_BITMASK;
+	lightInfluence |= indoorLightInfluence & INDOOR_LIGHTING_BITMASK;
+}
+
+void Chunk::SetBlockOutdoorLightInfluence(int blockIndex, int outdoorLightInfluence)
+{
+	uint8_t& lightInfluence = m_blocks->m_lightInfluences[blockIndex];
+	lightInfluence &= ~(OUTDOOR_LIGHTING_BITMASK << INDOOR_LIGHTING_BITS);
+	lightInfluence |= (outdoorLightInfluence & OUTDOOR_LIGHTING_BITMASK) << INDOOR_LIGHTING_BITS;
+}
+
+void Chunk::SetBlockLightInfluence(int blockIndex, bool isOutdoor, int lightInfluence)
+{
+	if (isOutdoor)
+	{
+		SetBlockOutdoorLightInfluence(blockIndex, lightInfluence);
+		return;
+	}
+
+	SetBlockIndoorLightInfluence(blockIndex, lightInfluence);
+}
+
+void Chunk::CompressBlocks()
+{
+	if (m_compressedBlocks)
+	{
+		return;
+	}
+
+	// Sections that became uniform through edits are picked up again, since nothing reads them until the next expansion
+	InitializeSectionUniformity();
+
+	m_compressedBlocks = new CompressedChunkBlocks();
+	for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
+	{
+		int sectionStartBlockIndex = sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+		m_compressedBlocks->m_sectionTypes[sectionIndex].Pack(&m_blocks->m_types[sectionStartBlockIndex], CHUNK_BLOCKS_PER_SECTION);
+		m_compressedBlocks->m_sectionLightInfluences[sectionIndex].Pack(&m_blocks->m_lightInfluences[sectionStartBlockIndex], CHUNK_BLOCKS_PER_SECTION);
+	}
+
+	delete m_blocks;
+	m_blocks = nullptr;
+
+	ReleaseLightingWorkBuffers();
+}
+
+void Chunk::ReleaseLightingWorkBuffers()
+{
+	// Queues grow to their peak during a relight and would otherwise keep that size for as long as the chunk is active
+	if (HasDirtyLighting())
+	{
+		return;
+	}
+
+	m_dirtyLightingBlocks.reset();
+	m_dirtyLightingQueue.Release();
+	m_lightRemovalQueue.Release();
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		std::vector<uint16_t>().swap(m_inboundDirtyLighting[sideIndex]);
+		std::vector<LightRemoval>().swap(m_inboundLightRemovals[sideIndex]);
+	}
+}
+
+void Chunk::ExpandBlocks()
+{
+	m_lastBlockAccessTime = GetCurrentTimeSeconds();
+	if (!m_compressedBlocks)
+	{
+		return;
+	}
+
+	m_blocks = new ChunkBlocks();
+	for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
+	{
+		int sectionStartBlockIndex = sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+		m_compressedBlocks->m_sectionTypes[sectionIndex].Unpack(&m_blocks->m_types[sectionStartBlockIndex]);
+		m_compressedBlocks->m_sectionLightInfluences[sectionIndex].Unpack(&m_blocks->m_lightInfluences[sectionStartBlockIndex]);
+	}
+	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+	{
+		m_blocks->m_flags[blockIndex] = BlockDefinition::s_blockProperties[m_blocks->m_types[blockIndex]].m_flags;
+	}
+
+	delete m_compressedBlocks;
+	m_compressedBlocks = nullptr;
+}
+
+void Chunk::ExpandBlocksWithNeighbors()
+{
+	ExpandBlocks();
+
+	Chunk* neighborChunks[] = { m_eastNeighbor, m_westNeighbor, m_northNeighbor, m_southNeighbor };
+	for (int neighborIndex = 0; neighborIndex < 4; neighborIndex++)
+	{
+		if (neighborChunks[neighborIndex])
+		{
+			neighborChunks[neighborIndex]->ExpandBlocks();
+		}
+	}
+}
+
+bool Chunk::AreBlocksCompressed() const
+{
+	return m_compressedBlocks != nullptr;
+}
+
+int Chunk::GetResidentBlockBytes() const
+{
+	// Lighting work lists are counted too, since they are per-chunk memory that compression is expected to give back
+	int numBytes = m_dirtyLightingQueue.GetCapacity() * (int)sizeof(uint16_t) + m_lightRemovalQueue.GetCapacity() * (int)sizeof(LightRemoval);
+	if (m_dirtyLightingBlocks)
+	{
+		numBytes += (int)sizeof(std::bitset<CHUNK_BLOCKS_TOTAL>);
+	}
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		numBytes += (int)(m_inboundDirtyLighting[sideIndex].capacity() * sizeof(uint16_t) + m_inboundLightRemovals[sideIndex].capacity() * sizeof(LightRemoval));
+	}
+
+	if (m_compressedBlocks)
+	{
+		numBytes += (int)sizeof(CompressedChunkBlocks);
+		for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
+		{
+			numBytes += m_compressedBlocks->m_sectionTypes[sectionIndex].GetNumBytes();
+			numBytes += m_compressedBlocks->m_sectionLightInfluences[sectionIndex].GetNumBytes();
+		}
+		return numBytes;
+	}
+
+	return numBytes + (int)sizeof(ChunkBlocks);
+}
+
+void Chunk::InitializeLighting()
+{
+	// Runs on a worker before the chunk is activated and hooked up to its neighbors
+	// Light is only flooded within the chunk; the world stitches it across borders on activation
+	InitializeSkyLight();
+
+	for (int emitterIndex = 0; emitterIndex < (int)m_emitterBlockIndexes.size(); emitterIndex++)
+	{
+		int blockIndex = m_emitterBlockIndexes[emitterIndex];
+		SetBlockIndoorLightInfluence(blockIndex, GetSourceLightInfluence(blockIndex, false));
+		MarkBlockLightingDirty(blockIndex);
+	}
+
+	ProcessDirtyLighting(INT_MAX);
+
+	// The whole chunk still has to be meshed, and it has no neighbors yet whose meshes could be affected
+	m_dirtyMeshSections = CHUNK_MESH_SECTIONS_ALL;
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		m_neighborDirtyMeshSections[sideIndex] = 0;
+	}
+}
+
+void Chunk::InitializeSkyLight()
+{
+	static_assert(CHUNK_SIZE_X == 16, "Skylight sweep packs one row of blocks into a 16-byte SSE register");
+
+	//--------------------------------------------------------------------------------
+	// Sweeps the chunk one layer at a time from the top, with each row of 16 blocks held in one register
+	// A layer takes the light of the layer above (undimmed in sky columns) and then spreads it sideways until it settles
+	// Light that would need to travel back up (e.g. out from under an overhang) is left to the dirty queue
+	__m128i const one = _mm_set1_epi8(1);
+	__m128i const maxLight = _mm_set1_epi8((char)OUTDOOR_LIGHTINFLUENCE_MAX);
+	__m128i const opaqueBitmask = _mm_set1_epi8((char)OPAQUE_BITMASK);
+	__m128i const indoorLightBitmask = _mm_set1_epi8((char)INDOOR_LIGHTING_BITMASK);
+
+	__m128i aboveLight[CHUNK_SIZE_Y];
+	__m128i aboveOpaque[CHUNK_SIZE_Y];
+	__m128i layerLight[CHUNK_SIZE_Y];
+	__m128i layerOpaque[CHUNK_SIZE_Y];
+
+	// Layers above the highest opaque block (typically the uniform air sections) are entirely sky and are filled without a sweep
+	int maxOpaqueHeight = 0;
+	for (int columnIndex = 0; columnIndex < CHUNK_BLOCKS_PER_LAYER; columnIndex++)
+	{
+		maxOpaqueHeight = GetMax(maxOpaqueHeight, (int)m_opaqueHeights[columnIndex]);
+	}
+
+	__m128i const skyLightInfluences = _mm_slli_epi16(maxLight, INDOOR_LIGHTING_BITS);
+	for (int rowStartIndex = maxOpaqueHeight << (CHUNK_XBITS + CHUNK_YBITS); rowStartIndex < CHUNK_BLOCKS_TOTAL; rowStartIndex += CHUNK_SIZE_X)
+	{
+		__m128i* rowLightInfluences = (__m128i*)&m_blocks->m_lightInfluences[rowStartIndex];
+		__m128i indoorLight = _mm_and_si128(_mm_load_si128(rowLightInfluences), indoorLightBitmask);
+		_mm_store_si128(rowLightInfluences, _mm_or_si128(indoorLight, skyLightInfluences));
+	}
+	for (int y = 0; y < CHUNK_SIZE_Y; y++)
+	{
+		aboveLight[y] = maxLight;
+		aboveOpaque[y] = _mm_setzero_si128();
+	}
+
+	for (int z = maxOpaqueHeight - 1; z >= 0; z--)
+	{
+		int layerStartIndex = z << (CHUNK_XBITS + CHUNK_YBITS);
+		__m128i const layerZ = _mm_set1_epi8((char)z);
+
+		__m128i isAnyBlockLit = _mm_setzero_si128();
+		for (int y = 0; y < CHUNK_SIZE_Y; y++)
+		{
+			int rowStartIndex = layerStartIndex | (y << CHUNK_XBITS);
+			__m128i rowFlags = _mm_load_si128((__m128i const*)&m_blocks->m_flags[rowStartIndex]);
+			layerOpaque[y] = _mm_cmpeq_epi8(_mm_and_si128(rowFlags, opaqueBitmask), opaqueBitmask);
+
+			// Sky blocks are the ones at or above their column's opaque height
+			__m128i opaqueHeights = _mm_loadu_si128((__m128i const*)&m_opaqueHeights[y << CHUNK_XBITS]);
+			__m128i isSky = _mm_cmpeq_epi8(_mm_max_epu8(opaqueHeights, layerZ), layerZ);
+
+			__m128i light = _mm_and_si128(isSky, maxLight);
+			if (z < CHUNK_SIZE_Z - 1)
+			{
+				light = _mm_max_epu8(light, _mm_subs_epu8(aboveLight[y], one));
+			}
+			layerLight[y] = _mm_andnot_si128(layerOpaque[y], light);
+			isAnyBlockLit = _mm_or_si128(isAnyBlockLit, layerLight[y]);
+		}
+
+		// Outdoor light only comes from above, so once a layer is fully dark every layer below it is too
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(isAnyBlockLit, _mm_setzero_si128())) == 0xFFFF)
+		{
+			break;
+		}
+
+		bool didLayerChange = true;
+		while (didLayerChange)
+		{
+			didLayerChange = false;
+			for (int y = 0; y < CHUNK_SIZE_Y; y++)
+			{
+				__m128i light = layerLight[y];
+				__m128i neighborLight = _mm_max_epu8(_mm_slli_si128(light, 1), _mm_srli_si128(light, 1));
+				if (y > 0)
+				{
+					neighborLight = _mm_max_epu8(neighborLight, layerLight[y - 1]);
+				}
+				if (y < CHUNK_SIZE_Y - 1)
+				{
+					neighborLight = _mm_max_epu8(neighborLight, layerLight[y + 1]);
+				}
+
+				__m128i spreadLight = _mm_max_epu8(light, _mm_andnot_si128(layerOpaque[y], _mm_subs_epu8(neighborLight, one)));
+				if (_mm_movemask_epi8(_mm_cmpeq_epi8(spreadLight, light)) != 0xFFFF)
+				{
+					layerLight[y] = spreadLight;
+					didLayerChange = true;
+				}
+			}
+		}
+
+		for (int y = 0; y < CHUNK_SIZE_Y; y++)
+		{
+			// Outdoor light goes in the high nibble; there is no byte shift, but light never exceeds 15 so a 16-bit shift is safe
+			int rowStartIndex = layerStartIndex | (y << CHUNK_XBITS);
+			__m128i* rowLightInfluences = (__m128i*)&m_blocks->m_lightInfluences[rowStartIndex];
+			__m128i indoorLight = _mm_and_si128(_mm_load_si128(rowLightInfluences), indoorLightBitmask);
+			_mm_store_si128(rowLightInfluences, _mm_or_si128(indoorLight, _mm_slli_epi16(layerLight[y], INDOOR_LIGHTING_BITS)));
+
+			// Blocks that could still brighten the non-opaque block above them seed the dirty queue
+			if (z < CHUNK_SIZE_Z - 1)
+			{
+				__m128i upwardLight = _mm_subs_epu8(layerLight[y], one);
+				__m128i isAboveLitEnough = _mm_cmpeq_epi8(_mm_max_epu8(aboveLight[y], upwardLight), aboveLight[y]);
+				int upwardSpreadMask = ~(_mm_movemask_epi8(_mm_or_si128(isAboveLitEnough, aboveOpaque[y]))) & 0xFFFF;
+				for (int x = 0; upwardSpreadMask != 0; x++, upwardSpreadMask >>= 1)
+				{
+					if (upwardSpreadMask & 1)
+					{
+						MarkBlockLightingDirty(rowStartIndex | x);
+					}
+				}
+			}
+		}
+
+		for (int y = 0; y < CHUNK_SIZE_Y; y++)
+		{
+			aboveLight[y] = layerLight[y];
+			aboveOpaque[y] = layerOpaque[y];
+		}
+	}
+}
+
+void Chunk::ReconcileSavedBorderLighting()
+{
+	// Saved light may include light that came across a border from a neighbor that has changed or is not loaded
+	// Only border blocks can hold such light directly; relighting them starts removal for anything that is now stale
+	for (int z = 0; z < CHUNK_SIZE_Z; z++)
+	{
+		for (int i = 0; i < CHUNK_SIZE_X; i++)
+		{
+			m_world->RelightBlock(BlockIter(this, GetBlockIndexFromCoords(i, 0, z)));
+			m_world->RelightBlock(BlockIter(this, GetBlockIndexFromCoords(i, CHUNK_SIZE_Y - 1, z)));
+		}
+		for (int i = 1; i < CHUNK_SIZE_Y - 1; i++)
+		{
+			m_world->RelightBlock(BlockIter(this, GetBlockIndexFromCoords(0, i, z)));
+			m_world->RelightBlock(BlockIter(this, GetBlockIndexFromCoords(CHUNK_SIZE_X - 1, i, z)));
+		}
+	}
+
+	m_hasSavedLighting = false;
+}
+
+void Chunk::MarkBlockLightingDirty(int blockIndex)
+{
+	if (!m_dirtyLightingBlocks)
+	{
+		m_dirtyLightingBlocks.reset(new std::bitset<CHUNK_BLOCKS_TOTAL>());
+	}
+	if (m_dirtyLightingBlocks->test(blockIndex))
+	{
+		return;
+	}
+
+	m_dirtyLightingBlocks->set(blockIndex);
+	m_dirtyLightingQueue.Push((uint16_t)blockIndex);
+}
+
+void Chunk::RelightBlock(int blockIndex)
+{
+	// Called after a block's type or sky flag was edited
+	// Light that goes up spreads through the dirty queue; light that goes down is cleared through the removal queue first
+	int maxNeighborIndoorLightInfluence = 0;
+	int maxNeighborOutdoorLightInfluence = 0;
+	GetMaxNeighborLightInfluences(blockIndex, maxNeighborIndoorLightInfluence, maxNeighborOutdoorLightInfluence);
+	int maxNeighborLightInfluences[] = { maxNeighborIndoorLightInfluence, maxNeighborOutdoorLightInfluence };
+
+	for (int channelIndex = 0; channelIndex < 2; channelIndex++)
+	{
+		bool isOutdoor = (channelIndex == 1);
+		int currentLightInfluence = GetBlockLightInfluence(blockIndex, isOutdoor);
+		int sourceLightInfluence = GetSourceLightInfluence(blockIndex, isOutdoor);
+
+		int lightInfluence = sourceLightInfluence;
+		if (!IsBlockOpaque(blockIndex))
+		{
+			lightInfluence = GetMax(sourceLightInfluence, maxNeighborLightInfluences[channelIndex] - 1);
+		}
+
+		if (lightInfluence < currentLightInfluence)
+		{
+			SetBlockLightInfluence(blockIndex, isOutdoor, sourceLightInfluence);
+			m_lightRemovalQueue.Push(LightRemoval(blockIndex, isOutdoor, currentLightInfluence));
+			if (sourceLightInfluence > 0)
+			{
+				MarkBlockLightingDirty(blockIndex);
+			}
+			MarkMeshDirtyAroundBlock(blockIndex);
+		}
+		else if (lightInfluence > currentLightInfluence)
+		{
+			SetBlockLightInfluence(blockIndex, isOutdoor, lightInfluence);
+			MarkBlockLightingDirty(blockIndex);
+			MarkMeshDirtyAroundBlock(blockIndex);
+		}
+	}
+}
+
+int Chunk::GetSourceLightInfluence(int blockIndex, bool isOutdoor) const
+{
+	if (isOutdoor)
+	{
+		return IsBlockSky(blockIndex) ? OUTDOOR_LIGHTINFLUENCE_MAX : 0;
+	}
+
+	return BlockDefinition::s_blockProperties[GetBlockType(blockIndex)].m_lightInfluence;
+}
+
+void Chunk::GetMaxNeighborLightInfluences(int blockIndex, int& out_indoorLightInfluence, int& out_outdoorLightInfluence)
+{
+	BlockIter blockIter = BlockIter(this, blockIndex);
+	BlockIter neighborBlocks[] = { blockIter.Step<Direction::EAST>(), blockIter.Step<Direction::WEST>(), blockIter.Step<Direction::NORTH>(), blockIter.Step<Direction::SOUTH>(), blockIter.Step<Direction::SKYWARD>(), blockIter.Step<Direction::GROUNDWARD>() };
+
+	out_indoorLightInfluence = 0;
+	out_outdoorLightInfluence = 0;
+	for (int neighborIndex = 0; neighborIndex < 6; neighborIndex++)
+	{
+		BlockIter const& neighborBlock = neighborBlocks[neighborIndex];
+		if (!neighborBlock.IsValid())
+		{
+			continue;
+		}
+
+		out_indoorLightInfluence = GetMax(out_indoorLightInfluence, neighborBlock.GetIndoorLightInfluence());
+		out_outdoorLightInfluence = GetMax(out_outdoorLightInfluence, neighborBlock.GetOutdoorLightInfluence());
+	}
+}
+
+bool Chunk::IsBlockLightingCorrect(int blockIndex)
+{
+	int maxNeighborIndoorLightInfluence = 0;
+	int maxNeighborOutdoorLightInfluence = 0;
+	GetMaxNeighborLightInfluences(blockIndex, maxNeighborIndoorLightInfluence, maxNeighborOutdoorLightInfluence);
+
+	int expectedIndoorLightInfluence = GetSourceLightInfluence(blockIndex, false);
+	int expectedOutdoorLightInfluence = GetSourceLightInfluence(blockIndex, true);
+	if (!IsBlockOpaque(blockIndex))
+	{
+		expectedIndoorLightInfluence = GetMax(expectedIndoorLightInfluence, maxNeighborIndoorLightInfluence - 1);
+		expectedOutdoorLightInfluence = GetMax(expectedOutdoorLightInfluence, maxNeighborOutdoorLightInfluence - 1);
+	}
+
+	return (GetBlockIndoorLightInfluence(blockIndex) == expectedIndoorLightInfluence) && (GetBlockOutdoorLightInfluence(blockIndex) == expectedOutdoorLightInfluence);
+}
+
+bool Chunk::HasDirtyLighting() const
+{
+	if (!m_dirtyLightingQueue.IsEmpty() || !m_lightRemovalQueue.IsEmpty())
+	{
+		return true;
+	}
+
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		if (!m_inboundDirtyLighting[sideIndex].empty() || !m_inboundLightRemovals[sideIndex].empty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void Chunk::ProcessDirtyLighting(int maxSteps)
+{
+	// Neighbors are idle while this chunk is being processed, so the inbound lists can be drained safely
+	// Removals are handled before additions so that re-spreading light never reads light that is about to be cleared
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		std::vector<LightRemoval>& inboundLightRemovals = m_inboundLightRemovals[sideIndex];
+		for (int inboundIndex = 0; inboundIndex < (int)inboundLightRemovals.size(); inboundIndex++)
+		{
+			LightRemoval const& lightRemoval = inboundLightRemovals[inboundIndex];
+			RemoveLightDependentOn(lightRemoval.m_blockIndex, lightRemoval.m_isOutdoor, lightRemoval.m_lightInfluence);
+		}
+		inboundLightRemovals.clear();
+	}
+
+	for (int sideIndex = 0; sideIndex < 4; sideIndex++)
+	{
+		std::vector<uint16_t>& inboundBlockIndexes = m_inboundDirtyLighting[sideIndex];
+		for (int inboundIndex = 0; inboundIndex < (int)inboundBlockIndexes.size(); inboundIndex++)
+		{
+			PullLightFromNeighbors(inboundBlockIndexes[inboundIndex]);
+		}
+		inboundBlockIndexes.clear();
+	}
+
+	int numSteps = 0;
+	while (numSteps < maxSteps && !m_lightRemovalQueue.IsEmpty())
+	{
+		ProcessNextLightRemoval();
+		numSteps++;
+	}
+
+	while (numSteps < maxSteps && m_lightRemovalQueue.IsEmpty() && !m_dirtyLightingQueue.IsEmpty())
+	{
+		ProcessNextDirtyLightBlock();
+		numSteps++;
+	}
+}
+
+void Chunk::ProcessNextDirtyLightBlock()
+{
+	int blockIndex = m_dirtyLightingQueue.Pop();
+	m_dirtyLightingBlocks->reset(blockIndex);
+
+	int indoorLightInfluence = GetBlockIndoorLightInfluence(blockIndex);
+	int outdoorLightInfluence = GetBlockOutdoorLightInfluence(blockIndex);
+
+	BlockIter blockIter = BlockIter(this, blockIndex);
+	SpreadLightToNeighbor(blockIter.Step<Direction::EAST>(), Direction::WEST, indoorLightInfluence, outdoorLightInfluence);
+	SpreadLightToNeighbor(blockIter.Step<Direction::WEST>(), Direction::EAST, indoorLightInfluence, outdoorLightInfluence);
+	SpreadLightToNeighbor(blockIter.Step<Direction::NORTH>(), Direction::SOUTH, indoorLightInfluence, outdoorLightInfluence);
+	SpreadLightToNeighbor(blockIter.Step<Direction::SOUTH>(), Direction::NORTH, indoorLightInfluence, outdoorLightInfluence);
+	SpreadLightToNeighbor(blockIter.Step<Direction::SKYWARD>(), Direction::GROUNDWARD, indoorLightInfluence, outdoorLightInfluence);
+	SpreadLightToNeighbor(blockIter.Step<Direction::GROUNDWARD>(), Direction::SKYWARD, indoorLightInfluence, outdoorLightInfluence);
+}
+
+void Chunk::SpreadLightToNeighbor(BlockIter const& neighborBlockIter, Direction inboundSide, int indoorLightInfluence, int outdoorLightInfluence)
+{
+	if (!neighborBlockIter.IsValid() || neighborBlockIter.IsOpaque())
+	{
+		return;
+	}
+
+	int neighborIndoorLightInfluence = neighborBlockIter.GetIndoorLightInfluence();
+	int neighborOutdoorLightInfluence = neighborBlockIter.GetOutdoorLightInfluence();
+	if (neighborIndoorLightInfluence >= indoorLightInfluence - 1 && neighborOutdoorLightInfluence >= outdoorLightInfluence - 1)
+	{
+		return;
+	}
+
+	if (neighborBlockIter.m_chunk != this)
+	{
+		// The neighboring chunk may be read by other jobs in this phase, so it pulls the light in itself in the next phase
+		neighborBlockIter.m_chunk->m_inboundDirtyLighting[(int)inboundSide].push_back((uint16_t)neighborBlockIter.m_blockIndex);
+		return;
+	}
+
+	SetBlockIndoorLightInfluence(neighborBlockIter.m_blockIndex, GetMax(neighborIndoorLightInfluence, indoorLightInfluence - 1));
+	SetBlockOutdoorLightInfluence(neighborBlockIter.m_blockIndex, GetMax(neighborOutdoorLightInfluence, outdoorLightInfluence - 1));
+	MarkBlockLightingDirty(neighborBlockIter.m_blockIndex);
+	MarkMeshDirtyAroundBlock(neighborBlockIter.m_blockIndex);
+}
+
+void Chunk::PullLightFromNeighbors(int blockIndex)
+{
+	if (IsBlockOpaque(blockIndex))
+	{
+		return;
+	}
+
+	int maxNeighborIndoorLightInfluence = 0;
+	int maxNeighborOutdoorLightInfluence = 0;
+	GetMaxNeighborLightInfluences(blockIndex, maxNeighborIndoorLightInfluence, maxNeighborOutdoorLightInfluence);
+
+	int currentIndoorLightInfluence = GetBlockIndoorLightInfluence(blockIndex);
+	int currentOutdoorLightInfluence = GetBlockOutdoorLightInfluence(blockIndex);
+	int indoorLightInfluence = GetMax(currentIndoorLightInfluence, maxNeighborIndoorLightInfluence - 1);
+	int outdoorLightInfluence = GetMax(currentOutdoorLightInfluence, maxNeighborOutdoorLightInfluence - 1);
+
+	if ((indoorLightInfluence != currentIndoorLightInfluence) || (outdoorLightInfluence != currentOutdoorLightInfluence))
+	{
+		SetBlockIndoorLightInfluence(blockIndex, indoorLightInfluence);
+		SetBlockOutdoorLightInfluence(blockIndex, outdoorLightInfluence);
+		MarkBlockLightingDirty(blockIndex);
+		MarkMeshDirtyAroundBlock(blockIndex);
+	}
+}
+
+void Chunk::ProcessNextLightRemoval()
+{
+	LightRemoval lightRemoval = m_lightRemovalQueue.Pop();
+
+	BlockIter blockIter = BlockIter(this, lightRemoval.m_blockIndex);
+	PropagateLightRemovalToNeighbor(blockIter.Step<Direction::EAST>(), Direction::WEST, lightRemoval);
+	PropagateLightRemovalToNeighbor(blockIter.Step<Direction::WEST>(), Direction::EAST, lightRemoval);
+	PropagateLightRemovalToNeighbor(blockIter.Step<Direction::NORTH>(), Direction::SOUTH, lightRemoval);
+	PropagateLightRemovalToNeighbor(blockIter.Step<Direction::SOUTH>(), Direction::NORTH, lightRemoval);
+	PropagateLightRemovalToNeighbor(blockIter.Step<Direction::SKYWARD>(), Direction::GROUNDWARD, lightRemoval);
+	PropagateLightRemovalToNeighbor(blockIter.Step<Direction::GROUNDWARD>(), Direction::SKYWARD, lightRemoval);
+}
+
+void Chunk::PropagateLightRemovalToNeighbor(BlockIter const& neighborBlockIter, Direction inboundSide, LightRemoval const& lightRemoval)
+{
+	if (!neighborBlockIter.IsValid())
+	{
+		return;
+	}
+
+	if (neighborBlockIter.m_chunk != this)
+	{
+		neighborBlockIter.m_chunk->m_inboundLightRemovals[(int)inboundSide].push_back(LightRemoval(neighborBlockIter.m_blockIndex, lightRemoval.m_isOutdoor, lightRemoval.m_lightInfluence));
+		return;
+	}
+
+	RemoveLightDependentOn(neighborBlockIter.m_blockIndex, lightRemoval.m_isOutdoor, lightRemoval.m_lightInfluence);
+}
+
+void Chunk::RemoveLightDependentOn(int blockIndex, bool isOutdoor, int removedLightInfluence)
+{
+	// A neighbor of a block that lost removedLightInfluence is only dimmer than it if it could have been lit by it
+	int lightInfluence = GetBlockLightInfluence(blockIndex, isOutdoor);
+	if (lightInfluence == 0)
+	{
+		return;
+	}
+
+	int sourceLightInfluence = GetSourceLightInfluence(blockIndex, isOutdoor);
+	if (lightInfluence < removedLightInfluence && lightInfluence > sourceLightInfluence)
+	{
+		SetBlockLightInfluence(blockIndex, isOutdoor, sourceLightInfluence);
+		m_lightRemovalQueue.Push(LightRemoval(blockIndex, isOutdoor, lightInfluence));
+		if (sourceLightInfluence > 0)
+		{
+			MarkBlockLightingDirty(blockIndex);
+		}
+		MarkMeshDirtyAroundBlock(blockIndex);
+		return;
+	}
+
+	// The block is lit independently of the removed light, so it spreads back into the area that was cleared
+	MarkBlockLightingDirty(blockIndex);
+}
+
+void Chunk::Generate()
+{
+	m_state = ChunkState::ACTIVATING_GENERATING;
+	GenerateChunkBlocks();
+	InitializeSectionUniformity();
+	InitializeHeightmaps();
+	InitializeEmitters();
+	InitializeLighting();
+	m_state = ChunkState::ACTIVATING_GENERATE_COMPLETE;
+}
+
+void ChunkGenerateJob::Execute()
+{
+	m_chunk->Generate();
+}
+
+void ChunkLoadJob::Execute()
+{
+	// A chunk that has no usable file is generated on the same worker, so the main thread never waits on either
+	if (!m_chunk->LoadFromFile())
+	{
+		m_chunk->DiscardLoadedBlocks();
+		m_chunk->Generate();
+		return;
+	}
+
+	m_chunk->InitializeSectionUniformity();
+	m_chunk->InitializeHeightmaps();
+	m_chunk->InitializeEmitters();
+	if (!m_chunk->m_hasSavedLighting)
+	{
+		m_chunk->InitializeLighting();
+	}
+}
+
+void ChunkSaveJob::Execute()
+{
+	m_world->SavePendingChunk(m_chunkCoords);
+}
+
+void ChunkReadAheadJob::Execute()
+{
+	for (int chunkIndex = 0; chunkIndex < (int)m_chunkCoords.size(); chunkIndex++)
+	{
+		m_world->GetRegionFileForChunk(m_chunkCoords[chunkIndex])->PrefetchChunk(m_chunkCoords[chunkIndex]);
+	}
+}
+
+void ChunkMeshJob::Execute()
+{
+	m_chunk->BuildMeshVertexes();
+}
+
+void ChunkLightingJob::Execute()
 {
-	m_chunk->m_state = ChunkState::ACTIVATING_GENERATING;
-	m_chunk->GenerateChunkBlocks();
-	m_chunk->PlaceBlockTemplates();
-	m_chunk->m_state = ChunkState::ACTIVATING_GENERATE_COMPLETE;
+	m_chunk->ProcessDirtyLighting(m_maxSteps);
 }
@@ -3,6 +3,8 @@
 #include "Game/Block.hpp"
 #include "Game/BlockIter.hpp"
 #include "Game/BlockTemplate.hpp"
+#include "Game/PaletteArray.hpp"
+#include "Game/RingBuffer.hpp"
 
 #include "Engine/Core/Vertex_PCU.hpp"
 #include "Engine/Core/JobSystem.hpp"
@@ -10,11 +12,12 @@
 #include "Engine/Math/Vec3.hpp"
 #include "Engine/Renderer/VertexBuffer.hpp"
 
-#include <queue>
+#include <bitset>
+#include <cstdint>
+#include <memory>
 #include <vector>
 
 
-struct Block;
 class World;
 
 #include "Engine/Math/IntVec3.hpp"
@@ -37,6 +40,29 @@ constexpr int CHUNK_BLOCKS_TOTAL = 1 << (CHUNK_XBITS + CHUNK_YBITS + CHUNK_ZBITS
 
 constexpr int CHUNK_GENERATION_NEIGHBORHOOD_OFFSET = 5;
 
+constexpr int CHUNK_FILE_HEADER_SIZE = 12;
+constexpr int CHUNK_FILE_VERSION_BLOCKS = 2;
+constexpr int CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING = 3;
+// Only the blocks that differ from the generator's output, as (index, type) pairs; see World::m_maxEditDeltaBlocks
+constexpr int CHUNK_FILE_VERSION_EDIT_DELTA = 4;
+// Per-section runs or bit-packed palettes with an optional LZ stage; see ChunkCodec.hpp
+constexpr int CHUNK_FILE_VERSION_PACKED = 5;
+
+// Meshes are built in horizontal sections so that a change only rebuilds the faces of the layers it touches
+constexpr int CHUNK_SECTION_ZBITS = 4;
+constexpr int CHUNK_SECTION_SIZE_Z = 1 << CHUNK_SECTION_ZBITS;
+constexpr int CHUNK_SECTION_BITMASK_Z = CHUNK_SECTION_SIZE_Z - 1;
+constexpr int CHUNK_NUM_SECTIONS = CHUNK_SIZE_Z / CHUNK_SECTION_SIZE_Z;
+constexpr int CHUNK_BLOCKS_PER_SECTION = CHUNK_BLOCKS_PER_LAYER * CHUNK_SECTION_SIZE_Z;
+constexpr uint8_t CHUNK_MESH_SECTIONS_ALL = (uint8_t)((1 << CHUNK_NUM_SECTIONS) - 1);
+static_assert(CHUNK_NUM_SECTIONS <= 8, "Dirty mesh sections no longer fit in a byte");
+
+// Lighting work lists store chunk-local block indexes, which must fit in 16 bits
+static_assert(CHUNK_BLOCKS_TOTAL <= 65536, "Chunk-local block indexes no longer fit in the lighting work lists");
+constexpr int CHUNK_LIGHTING_QUEUE_INITIAL_CAPACITY = 1024;
+
+static_assert(CHUNK_SIZE_Z <= 255, "Column heights no longer fit in the chunk heightmaps");
+
 class Chunk;
 
 
@@ -59,6 +85,52 @@ enum class ChunkState
 	NUM_CHUNK_STATES
 };
 
+// Block data is stored as one contiguous array per channel instead of an array of structs,
+// so a pass over one channel (flags for meshing, light for saving) only touches the bytes it needs
+// and whole rows of blocks can be loaded into a SIMD register at once
+struct alignas(64) ChunkBlocks
+{
+public:
+	BlockDefinitionID m_types[CHUNK_BLOCKS_TOTAL] = {};
+	uint8_t m_lightInfluences[CHUNK_BLOCKS_TOTAL] = {};
+	uint8_t m_flags[CHUNK_BLOCKS_TOTAL] = {};
+};
+static_assert(CHUNK_SIZE_X == 16, "Block rows are no longer one SIMD register wide");
+
+// Storage for a chunk that has not been touched for a while; flags are rebuilt from the types when it is expanded
+// Each section gets its own palettes, so sections of pure air or pure stone (with constant light) cost almost nothing
+struct CompressedChunkBlocks
+{
+public:
+	PaletteArray m_sectionTypes[CHUNK_NUM_SECTIONS];
+	PaletteArray m_sectionLightInfluences[CHUNK_NUM_SECTIONS];
+};
+
+struct LightRemoval
+{
+public:
+	uint16_t m_blockIndex = 0;
+	bool m_isOutdoor = false;
+	uint8_t m_lightInfluence = 0;
+
+public:
+	LightRemoval() = default;
+	LightRemoval(int blockIndex, bool isOutdoor, int lightInfluence) : m_blockIndex((uint16_t)blockIndex), m_isOutdoor(isOutdoor), m_lightInfluence((uint8_t)lightInfluence) {}
+};
+
+// Blocks of a deactivated chunk waiting to be written to disk; nothing writes to them once the chunk has handed them over,
+// so the save worker can encode them while the main thread moves on
+struct ChunkSaveSnapshot
+{
+public:
+	IntVec2 m_coords;
+	int m_chunkFileVersion = CHUNK_FILE_VERSION_BLOCKS;
+	bool m_saveLighting = false;
+	int m_maxEditDeltaBlocks = 0;
+	int m_numEditedBlocks = CHUNK_BLOCKS_TOTAL;
+	std::unique_ptr<ChunkBlocks> m_blocks;
+};
+
 class ChunkGenerateJob : public Job
 {
 public:
@@ -69,6 +141,61 @@ public:
 	Chunk* m_chunk = nullptr;
 };
 
+class ChunkLoadJob : public Job
+{
+public:
+	ChunkLoadJob(Chunk* chunk) : m_chunk(chunk) {}
+	virtual void Execute() override;
+
+public:
+	Chunk* m_chunk = nullptr;
+};
+
+class ChunkSaveJob : public Job
+{
+public:
+	ChunkSaveJob(World* world, IntVec2 const& chunkCoords) : m_world(world), m_chunkCoords(chunkCoords) {}
+	virtual void Execute() override;
+
+public:
+	World* m_world = nullptr;
+	IntVec2 m_chunkCoords;
+};
+
+// Faults the region file pages of chunks the player is heading towards into memory before they are activated
+class ChunkReadAheadJob : public Job
+{
+public:
+	ChunkReadAheadJob(World* world, std::vector<IntVec2> const& chunkCoords) : m_world(world), m_chunkCoords(chunkCoords) {}
+	virtual void Execute() override;
+
+public:
+	World* m_world = nullptr;
+	std::vector<IntVec2> m_chunkCoords;
+};
+
+// Builds the vertexes of a chunk whose blocks (and its neighbors') are already expanded; the mesh is uploaded on the main thread
+class ChunkMeshJob : public Job
+{
+public:
+	ChunkMeshJob(Chunk* chunk) : m_chunk(chunk) {}
+	virtual void Execute() override;
+
+public:
+	Chunk* m_chunk = nullptr;
+};
+
+class ChunkLightingJob : public Job
+{
+public:
+	ChunkLightingJob(Chunk* chunk, int maxSteps) : m_chunk(chunk), m_maxSteps(maxSteps) {}
+	virtual void Execute() override;
+
+public:
+	Chunk* m_chunk = nullptr;
+	int m_maxSteps = 0;
+};
+
 
 class Chunk
 {
@@ -78,42 +205,129 @@ public:
 	Chunk(World* world, IntVec2 const& chunkCoords);
 
 	bool LoadFromFile();
-	bool SaveToFile() const;
+	void LoadFromSnapshot(ChunkSaveSnapshot const& snapshot);
+	bool LoadFromBuffer(uint8_t const* chunkFileData, size_t chunkFileSize);
+	bool LoadEditDeltaFromBuffer(uint8_t const* chunkFileData, size_t chunkFileSize);
+	bool LoadPackedFromBuffer(uint8_t const* chunkFileData, size_t chunkFileSize);
+	void DiscardLoadedBlocks();
+	static bool DecodeChunkFileRuns(uint8_t const* chunkFileData, size_t chunkFileSize, size_t& chunkFileReadIndex, uint8_t* out_values, uint8_t* out_flags);
+	void Generate();
+	ChunkSaveSnapshot* TakeSaveSnapshot();
+	static void WriteChunkFileBuffer(ChunkSaveSnapshot const& snapshot, World* world, std::vector<uint8_t>& fileBuffer);
 	void GenerateChunkBlocks();
-	void PlaceBlockTemplates();
+	static void GenerateChunkBlockTypes(World const* world, IntVec2 const& chunkCoords, BlockDefinitionID* out_blockTypes);
 	void RebuildMesh();
+	void BuildMeshVertexes();
+	void UploadMesh();
 
 	void Update();
 	void Render() const;
 	void RenderDebug() const;
-	unsigned char ComputeBlockTypeAtIndex(IntVec3 const& neighboorhoodColCoords, int terrainHeights[], float humidityArr[], float temperatureArr[], float forestness[], float treeRawNoise[]);
+	static unsigned char ComputeBlockTypeAtIndex(int worldSeed, IntVec3 const& chunkOrigin, IntVec3 const& neighboorhoodColCoords, int terrainHeights[], float humidityArr[], float temperatureArr[], float forestness[], float treeRawNoise[], std::vector<BlockTemplateToDo>& out_blockTemplates);
 	IntVec3 GetBlockCoordsFromIndex(int blockIndex) const;
-	int GetBlockIndexFromCoords(IntVec3 const& blockCoords) const;
-	int GetBlockIndexFromCoords(int blockX, int blockY, int blockZ) const;
+	static int GetBlockIndexFromCoords(IntVec3 const& blockCoords);
+	static int GetBlockIndexFromCoords(int blockX, int blockY, int blockZ);
 	IntVec3 GetBlockCoordsFromWorldPosition(Vec3 const& worldPosition) const;
-	bool AreBlockCoordsInChunk(IntVec3 const& blockCoords) const;
+	static bool AreBlockCoordsInChunk(IntVec3 const& blockCoords);
 	bool AddBlockAtWorldPosition(Vec3 const& worldPosition, BlockDefinitionID type);
 	bool DigBlockAtWorldPosition(Vec3 const& worldPosition);
-	void AddVertsForBlock(int blockIndex);
-	bool IsBlockOpaque(Block const* block) const;
-	bool IsLocalMaximum(IntVec2 const& blockCoords, float rawNoise[], int range) const;
+	void SetBlockType(int blockIndex, BlockDefinitionID blockType);
+	void InitializeHeightmaps();
+	void InitializeEmitters();
+	void UpdateHeightmapsForBlock(int blockIndex);
+	int FindColumnHeight(int columnIndex, int startZ, bool isOpaqueHeight) const;
+	bool IsBlockSky(int blockIndex) const;
+	int GetSurfaceHeight(int columnIndex) const;
+	void AddVertsForBlock(std::vector<Vertex_PCU>& verts, int blockIndex);
+	void AddVertsForSectionShell(std::vector<Vertex_PCU>& verts, int sectionIndex);
+	void InitializeSectionUniformity();
+	bool IsSectionUniform(int sectionIndex) const;
+	bool IsBlockSolidInUniformSection(int blockIndex, bool& out_isSolid) const;
+	void MarkMeshDirtyAroundBlock(int blockIndex);
+	void ApplyNeighborMeshDirtying();
+	BlockDefinitionID GetBlockType(int blockIndex) const;
+	void SetBlockTypeID(int blockIndex, BlockDefinitionID blockType);
+	bool IsBlockVisible(int blockIndex) const;
+	bool IsBlockSolid(int blockIndex) const;
+	bool IsBlockOpaque(int blockIndex) const;
+	bool IsBlockWater(int blockIndex) const;
+	int GetBlockIndoorLightInfluence(int blockIndex) const;
+	int GetBlockOutdoorLightInfluence(int blockIndex) const;
+	int GetBlockLightInfluence(int blockIndex, bool isOutdoor) const;
+	void SetBlockIndoorLightInfluence(int blockIndex, int indoorLightInfluence);
+	void SetBlockOutdoorLightInfluence(int blockIndex, int outdoorLightInfluence);
+	void SetBlockLightInfluence(int blockIndex, bool isOutdoor, int lightInfluence);
+	void CompressBlocks();
+	void ExpandBlocks();
+	void ExpandBlocksWithNeighbors();
+	bool AreBlocksCompressed() const;
+	int GetResidentBlockBytes() const;
+	void ReleaseLightingWorkBuffers();
+
+	void InitializeLighting();
+	void InitializeSkyLight();
+	void ReconcileSavedBorderLighting();
+	void MarkBlockLightingDirty(int blockIndex);
+	void RelightBlock(int blockIndex);
+	int GetSourceLightInfluence(int blockIndex, bool isOutdoor) const;
+	void GetMaxNeighborLightInfluences(int blockIndex, int& out_indoorLightInfluence, int& out_outdoorLightInfluence);
+	bool IsBlockLightingCorrect(int blockIndex);
+	bool HasDirtyLighting() const;
+	void ProcessDirtyLighting(int maxSteps);
+	void ProcessNextDirtyLightBlock();
+	void SpreadLightToNeighbor(BlockIter const& neighborBlockIter, Direction inboundSide, int indoorLightInfluence, int outdoorLightInfluence);
+	void PullLightFromNeighbors(int blockIndex);
+	void ProcessNextLightRemoval();
+	void PropagateLightRemovalToNeighbor(BlockIter const& neighborBlockIter, Direction inboundSide, LightRemoval const& lightRemoval);
+	void RemoveLightDependentOn(int blockIndex, bool isOutdoor, int removedLightInfluence);
+	static bool IsLocalMaximum(IntVec2 const& blockCoords, float rawNoise[], int range);
 
 public:
 	World* m_world = nullptr;
 	IntVec2 m_coords;
 	Vec3 m_worldPosition;
 	AABB3 m_worldBounds;
-	Block* m_blocks = nullptr;
+	// Exactly one of these is set; anything reading or writing blocks must expand the chunk (and any neighbor it reads) first
+	ChunkBlocks* m_blocks = nullptr;
+	CompressedChunkBlocks* m_compressedBlocks = nullptr;
+	double m_lastBlockAccessTime = 0.0;
+	// Sections made of a single block type, tracked in both storage modes so that passes can skip them without reading blocks
+	// A bit is only cleared by writes, so it may miss sections that became uniform until it is recomputed
+	uint8_t m_uniformSections = 0;
+	BlockDefinitionID m_sectionUniformTypes[CHUNK_NUM_SECTIONS] = {};
 	std::vector<Vertex_PCU> m_vertexes;
 	VertexBuffer* m_vertexBuffer = nullptr;
 	std::vector<Vertex_PCU> m_debugVertexes;
-	bool m_isCpuMeshDirty = true;
+	int m_sectionVertexOffsets[CHUNK_NUM_SECTIONS + 1] = {};
+	uint8_t m_dirtyMeshSections = CHUNK_MESH_SECTIONS_ALL;
+	uint8_t m_neighborDirtyMeshSections[4] = {};
 	bool m_needsSaving = false;
+	bool m_hasSavedLighting = false;
 	Chunk* m_eastNeighbor = nullptr;
 	Chunk* m_westNeighbor = nullptr;
 	Chunk* m_northNeighbor = nullptr;
 	Chunk* m_southNeighbor = nullptr;
 	int m_chunkRenderedVerts = 0;
-	std::vector<BlockTemplateToDo> m_blockTemplateSpawnToDo;
+	// Upper bound on the blocks that differ from the generator's output; chunks loaded from a full file count as entirely edited
+	int m_numEditedBlocks = 0;
+
+	// One past the highest opaque and the highest non-air block in each column, or 0 for an empty column
+	// Blocks at or above the opaque height are sky
+	uint8_t m_opaqueHeights[CHUNK_BLOCKS_PER_LAYER] = {};
+	uint8_t m_surfaceHeights[CHUNK_BLOCKS_PER_LAYER] = {};
+	std::vector<uint16_t> m_emitterBlockIndexes;
+
+	// Lighting work is partitioned per chunk so that non-adjacent chunks can be solved in parallel
+	// Work crossing a chunk border is written to the neighbor's inbound list for the side it arrives from,
+	// so each list has a single writer during a lighting phase and is drained by its owner in the next phase
+	// Dirty blocks spread their light to their neighbors; removals clear light that depended on a dimmed block
+	// Work lists hold chunk-local indexes in preallocated ring buffers, and the bitset tracks queue membership
+	// All of them are released while the chunk is compressed (it has no lighting work then) and allocated again on demand
+	RingBuffer<uint16_t> m_dirtyLightingQueue;
+	RingBuffer<LightRemoval> m_lightRemovalQueue;
+	std::unique_ptr<std::bitset<CHUNK_BLOCKS_TOTAL>> m_dirtyLightingBlocks;
+	std::vector<uint16_t> m_inboundDirtyLighting[4];
+	std::vector<LightRemoval> m_inboundLightRemovals[4];
+	bool m_isInLightingWorklist = false;
 	std::atomic<ChunkState> m_state = ChunkState::CONSTRUCTING;
 };
@@ -0,0 +1,364 @@
+#include "Game/ChunkCodec.hpp"
+
+#include "Game/Chunk.hpp"
+#include "Game/PaletteArray.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+
+constexpr int LZ_HASH_BITS = 12;
+constexpr int LZ_MIN_MATCH_LENGTH = 4;
+constexpr int LZ_MAX_OFFSET = 65535;
+
+// A section stored as 8-bit palette indexes (plus a full palette) is the largest a channel can get
+constexpr size_t PACKED_CHUNK_MAX_CHANNELS_SIZE = 2 * CHUNK_NUM_SECTIONS * (1 + 1 + 256 + CHUNK_BLOCKS_PER_SECTION);
+
+
+static uint32_t ReadUint32Unaligned(uint8_t const* bytes)
+{
+	uint32_t value;
+	memcpy(&value, bytes, sizeof(value));
+	return value;
+}
+
+static void WriteLZLength(std::vector<uint8_t>& buffer, int length)
+{
+	while (length >= 255)
+	{
+		buffer.push_back(255);
+		length -= 255;
+	}
+	buffer.push_back((uint8_t)length);
+}
+
+static bool ReadLZLength(uint8_t const* data, size_t dataSize, size_t& readIndex, size_t& inout_length)
+{
+	uint8_t lengthByte = 255;
+	while (lengthByte == 255)
+	{
+		if (readIndex >= dataSize)
+		{
+			return false;
+		}
+		lengthByte = data[readIndex];
+		readIndex++;
+		inout_length += lengthByte;
+	}
+	return true;
+}
+
+
+void EncodePackedChunkFileBody(uint8_t const* blockTypes, uint8_t const* lightInfluences, std::vector<uint8_t>& fileBuffer)
+{
+	uint8_t storageFlags = lightInfluences ? CHUNK_STORAGE_HAS_LIGHT : 0;
+
+	std::vector<uint8_t> channels;
+	channels.reserve(CHUNK_BLOCKS_TOTAL / 8);
+	EncodeChunkChannel(blockTypes, channels);
+	if (lightInfluences)
+	{
+		EncodeChunkChannel(lightInfluences, channels);
+	}
+
+	std::vector<uint8_t> compressedChannels;
+	WriteVarint(compressedChannels, (uint32_t)channels.size());
+	CompressLZ(channels.data(), channels.size(), compressedChannels);
+
+	if (compressedChannels.size() < channels.size())
+	{
+		fileBuffer.push_back(storageFlags | CHUNK_STORAGE_LZ);
+		fileBuffer.insert(fileBuffer.end(), compressedChannels.begin(), compressedChannels.end());
+	}
+	else
+	{
+		fileBuffer.push_back(storageFlags);
+		fileBuffer.insert(fileBuffer.end(), channels.begin(), channels.end());
+	}
+}
+
+bool DecodePackedChunkFileBody(uint8_t const* bodyData, size_t bodySize, uint8_t* out_blockTypes, uint8_t* out_lightInfluences, bool& out_hasLight)
+{
+	if (bodySize < 1)
+	{
+		return false;
+	}
+
+	uint8_t storageFlags = bodyData[0];
+	size_t bodyReadIndex = 1;
+
+	uint8_t const* channels = bodyData + bodyReadIndex;
+	size_t channelsSize = bodySize - bodyReadIndex;
+	std::vector<uint8_t> decompressedChannels;
+	if (storageFlags & CHUNK_STORAGE_LZ)
+	{
+		uint32_t decompressedChannelsSize = 0;
+		if (!ReadVarint(bodyData, bodySize, bodyReadIndex, decompressedChannelsSize) || decompressedChannelsSize > PACKED_CHUNK_MAX_CHANNELS_SIZE)
+		{
+			return false;
+		}
+
+		decompressedChannels.resize(decompressedChannelsSize);
+		if (!DecompressLZ(bodyData + bodyReadIndex, bodySize - bodyReadIndex, decompressedChannels.data(), decompressedChannels.size()))
+		{
+			return false;
+		}
+		channels = decompressedChannels.data();
+		channelsSize = decompressedChannels.size();
+	}
+
+	size_t channelsReadIndex = 0;
+	if (!DecodeChunkChannel(channels, channelsSize, channelsReadIndex, out_blockTypes))
+	{
+		return false;
+	}
+
+	out_hasLight = (storageFlags & CHUNK_STORAGE_HAS_LIGHT) != 0;
+	if (out_hasLight && !DecodeChunkChannel(channels, channelsSize, channelsReadIndex, out_lightInfluences))
+	{
+		return false;
+	}
+
+	return channelsReadIndex == channelsSize;
+}
+
+void EncodeChunkChannel(uint8_t const* values, std::vector<uint8_t>& buffer)
+{
+	std::vector<uint8_t> runs;
+	std::vector<uint8_t> paletteIndexes;
+	PaletteArray sectionPalette;
+	for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
+	{
+		uint8_t const* sectionValues = values + sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+
+		runs.clear();
+		int runStartIndex = 0;
+		for (int valueIndex = 1; valueIndex <= CHUNK_BLOCKS_PER_SECTION; valueIndex++)
+		{
+			if (valueIndex == CHUNK_BLOCKS_PER_SECTION || sectionValues[valueIndex] != sectionValues[runStartIndex])
+			{
+				runs.push_back(sectionValues[runStartIndex]);
+				WriteVarint(runs, (uint32_t)(valueIndex - runStartIndex));
+				runStartIndex = valueIndex;
+			}
+		}
+
+		// Noisy sections (ore veins, light gradients) pack much better as indexes than as runs
+		paletteIndexes.clear();
+		sectionPalette.Pack(sectionValues, CHUNK_BLOCKS_PER_SECTION);
+		sectionPalette.WriteToBuffer(paletteIndexes);
+
+		if (runs.size() <= paletteIndexes.size())
+		{
+			buffer.push_back(CHUNK_SECTION_ENCODING_RUNS);
+			buffer.insert(buffer.end(), runs.begin(), runs.end());
+		}
+		else
+		{
+			buffer.push_back(CHUNK_SECTION_ENCODING_PALETTE);
+			buffer.insert(buffer.end(), paletteIndexes.begin(), paletteIndexes.end());
+		}
+	}
+}
+
+bool DecodeChunkChannel(uint8_t const* data, size_t dataSize, size_t& readIndex, uint8_t* out_values)
+{
+	PaletteArray sectionPalette;
+	for (int sectionIndex = 0; sectionIndex < CHUNK_NUM_SECTIONS; sectionIndex++)
+	{
+		uint8_t* sectionValues = out_values + sectionIndex * CHUNK_BLOCKS_PER_SECTION;
+		if (readIndex >= dataSize)
+		{
+			return false;
+		}
+
+		uint8_t sectionEncoding = data[readIndex];
+		readIndex++;
+		if (sectionEncoding == CHUNK_SECTION_ENCODING_PALETTE)
+		{
+			if (!sectionPalette.ReadFromBuffer(data, dataSize, readIndex, CHUNK_BLOCKS_PER_SECTION))
+			{
+				return false;
+			}
+			sectionPalette.Unpack(sectionValues);
+			continue;
+		}
+
+		if (sectionEncoding != CHUNK_SECTION_ENCODING_RUNS)
+		{
+			return false;
+		}
+
+		uint32_t valueIndex = 0;
+		while (valueIndex < (uint32_t)CHUNK_BLOCKS_PER_SECTION)
+		{
+			if (readIndex >= dataSize)
+			{
+				return false;
+			}
+			uint8_t value = data[readIndex];
+			readIndex++;
+
+			uint32_t numValues = 0;
+			if (!ReadVarint(data, dataSize, readIndex, numValues) || numValues == 0 || numValues > (uint32_t)CHUNK_BLOCKS_PER_SECTION - valueIndex)
+			{
+				return false;
+			}
+
+			memset(&sectionValues[valueIndex], value, numValues);
+			valueIndex += numValues;
+		}
+	}
+
+	return true;
+}
+
+void CompressLZ(uint8_t const* data, size_t dataSize, std::vector<uint8_t>& buffer)
+{
+	// Positions of the last 4-byte sequence seen with each hash; a stale or colliding entry just fails the match check
+	int lastPositionsForHash[1 << LZ_HASH_BITS];
+	for (int hashIndex = 0; hashIndex < (1 << LZ_HASH_BITS); hashIndex++)
+	{
+		lastPositionsForHash[hashIndex] = -1;
+	}
+
+	size_t literalStartIndex = 0;
+	size_t dataIndex = 0;
+	while (dataIndex + LZ_MIN_MATCH_LENGTH <= dataSize)
+	{
+		uint32_t sequence = ReadUint32Unaligned(data + dataIndex);
+		uint32_t hash = (sequence * 2654435761u) >> (32 - LZ_HASH_BITS);
+		int matchIndex = lastPositionsForHash[hash];
+		lastPositionsForHash[hash] = (int)dataIndex;
+
+		if (matchIndex < 0 || dataIndex - (size_t)matchIndex > LZ_MAX_OFFSET || ReadUint32Unaligned(data + matchIndex) != sequence)
+		{
+			dataIndex++;
+			continue;
+		}
+
+		size_t matchLength = LZ_MIN_MATCH_LENGTH;
+		while (dataIndex + matchLength < dataSize && data[matchIndex + matchLength] == data[dataIndex + matchLength])
+		{
+			matchLength++;
+		}
+
+		int numLiterals = (int)(dataIndex - literalStartIndex);
+		int extraMatchLength = (int)matchLength - LZ_MIN_MATCH_LENGTH;
+		buffer.push_back((uint8_t)((std::min(numLiterals, 15) << 4) | std::min(extraMatchLength, 15)));
+		if (numLiterals >= 15)
+		{
+			WriteLZLength(buffer, numLiterals - 15);
+		}
+		buffer.insert(buffer.end(), data + literalStartIndex, data + dataIndex);
+
+		int offset = (int)(dataIndex - (size_t)matchIndex);
+		buffer.push_back((uint8_t)(offset));
+		buffer.push_back((uint8_t)(offset >> 8));
+		if (extraMatchLength >= 15)
+		{
+			WriteLZLength(buffer, extraMatchLength - 15);
+		}
+
+		dataIndex += matchLength;
+		literalStartIndex = dataIndex;
+	}
+
+	// The stream always ends with a token that only has literals (possibly none)
+	int numLiterals = (int)(dataSize - literalStartIndex);
+	buffer.push_back((uint8_t)(std::min(numLiterals, 15) << 4));
+	if (numLiterals >= 15)
+	{
+		WriteLZLength(buffer, numLiterals - 15);
+	}
+	buffer.insert(buffer.end(), data + literalStartIndex, data + dataSize);
+}
+
+bool DecompressLZ(uint8_t const* data, size_t dataSize, uint8_t* out_data, size_t outDataSize)
+{
+	size_t readIndex = 0;
+	size_t writeIndex = 0;
+	while (readIndex < dataSize)
+	{
+		uint8_t token = data[readIndex];
+		readIndex++;
+
+		size_t numLiterals = token >> 4;
+		if (numLiterals == 15 && !ReadLZLength(data, dataSize, readIndex, numLiterals))
+		{
+			return false;
+		}
+		if (numLiterals > dataSize - readIndex || numLiterals > outDataSize - writeIndex)
+		{
+			return false;
+		}
+		memcpy(out_data + writeIndex, data + readIndex, numLiterals);
+		readIndex += numLiterals;
+		writeIndex += numLiterals;
+
+		if (readIndex == dataSize)
+		{
+			break;
+		}
+
+		if (readIndex + 2 > dataSize)
+		{
+			return false;
+		}
+		size_t offset = (size_t)data[readIndex] | ((size_t)data[readIndex + 1] << 8);
+		readIndex += 2;
+
+		size_t matchLength = token & 15;
+		if (matchLength == 15 && !ReadLZLength(data, dataSize, readIndex, matchLength))
+		{
+			return false;
+		}
+		matchLength += LZ_MIN_MATCH_LENGTH;
+		if (offset == 0 || offset > writeIndex || matchLength > outDataSize - writeIndex)
+		{
+			return false;
+		}
+
+		// Matches may overlap the bytes they produce (a run of one value has an offset of 1), so they are copied forwards one byte at a time
+		uint8_t const* matchData = out_data + writeIndex - offset;
+		for (size_t matchIndex = 0; matchIndex < matchLength; matchIndex++)
+		{
+			out_data[writeIndex + matchIndex] = matchData[matchIndex];
+		}
+		writeIndex += matchLength;
+	}
+
+	return writeIndex == outDataSize;
+}
+
+void WriteVarint(std::vector<uint8_t>& buffer, uint32_t value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back((uint8_t)(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back((uint8_t)value);
+}
+
+bool ReadVarint(uint8_t const* data, size_t dataSize, size_t& readIndex, uint32_t& out_value)
+{
+	out_value = 0;
+	for (int shift = 0; shift < 35; shift += 7)
+	{
+		if (readIndex >= dataSize)
+		{
+			return false;
+		}
+
+		uint8_t varintByte = data[readIndex];
+		readIndex++;
+		out_value |= (uint32_t)(varintByte & 0x7F) << shift;
+		if ((varintByte & 0x80) == 0)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------
+// Body of a packed chunk file (CHUNK_FILE_VERSION_PACKED), following the usual 12-byte chunk file header:
+//     storage flags byte, then either the channels as they are or, with CHUNK_STORAGE_LZ, a varint channel size and an LZ stream of them
+// The block type channel comes first, followed by the light channel if the file has CHUNK_STORAGE_HAS_LIGHT
+// Each channel is stored per mesh section, either as (value, varint count) runs or as a bit-packed PaletteArray,
+// whichever is smaller for that section; the encoder also keeps the LZ stage only when it makes the chunk smaller
+constexpr uint8_t CHUNK_STORAGE_HAS_LIGHT = 1;
+constexpr uint8_t CHUNK_STORAGE_LZ = 2;
+
+constexpr uint8_t CHUNK_SECTION_ENCODING_RUNS = 0;
+constexpr uint8_t CHUNK_SECTION_ENCODING_PALETTE = 1;
+
+
+void EncodePackedChunkFileBody(uint8_t const* blockTypes, uint8_t const* lightInfluences, std::vector<uint8_t>& fileBuffer);
+bool DecodePackedChunkFileBody(uint8_t const* bodyData, size_t bodySize, uint8_t* out_blockTypes, uint8_t* out_lightInfluences, bool& out_hasLight);
+
+void EncodeChunkChannel(uint8_t const* values, std::vector<uint8_t>& buffer);
+bool DecodeChunkChannel(uint8_t const* data, size_t dataSize, size_t& readIndex, uint8_t* out_values);
+
+// LZ4-style block compression: (literal count, match length) tokens, literals, then a 2-byte offset back into the output
+void CompressLZ(uint8_t const* data, size_t dataSize, std::vector<uint8_t>& buffer);
+bool DecompressLZ(uint8_t const* data, size_t dataSize, uint8_t* out_data, size_t outDataSize);
+
+void WriteVarint(std::vector<uint8_t>& buffer, uint32_t value);
+bool ReadVarint(uint8_t const* data, size_t dataSize, size_t& readIndex, uint32_t& out_value);
@@ -60,11 +60,57 @@ bool Game::Event_GameClock(EventArgs& args)
 	return true;
 }
 
+bool Game::Event_LightingStressTest(EventArgs& args)
+{
+	bool isHelp = args.GetValue("help", false);
+	if (isHelp)
+	{
+		g_console->AddLine("Makes random block edits in active chunks, undoes them, and checks lighting against a full recompute after each", false);
+		g_console->AddLine("Parameters", false);
+		g_console->AddLine(Stringf("\t\t%-20s: [int > 0] number of random edits to make (default 100)", "edits"), false);
+		return true;
+	}
+
+	if (!g_app->m_game->m_world)
+	{
+		g_console->AddLine("No world to run the lighting stress test in");
+		return false;
+	}
+
+	int numEdits = args.GetValue("edits", 100);
+	g_app->m_game->m_world->RunLightingStressTest(numEdits);
+	return true;
+}
+
+bool Game::Event_ChunkCodecBenchmark(EventArgs& args)
+{
+	bool isHelp = args.GetValue("help", false);
+	if (isHelp)
+	{
+		g_console->AddLine("Encodes and decodes every active chunk with each chunk file codec and reports sizes and throughput", false);
+		g_console->AddLine("Parameters", false);
+		g_console->AddLine(Stringf("\t\t%-20s: [int > 0] number of times to code each chunk (default 10)", "iterations"), false);
+		return true;
+	}
+
+	if (!g_app->m_game->m_world)
+	{
+		g_console->AddLine("No world to run the chunk codec benchmark in");
+		return false;
+	}
+
+	int numIterations = args.GetValue("iterations", 10);
+	g_app->m_game->m_world->RunChunkCodecBenchmark(numIterations);
+	return true;
+}
+
 Game::Game()
 {
 	LoadAssets();
 	BlockTemplate::InitializeBlockTemplates();
 	SubscribeEventCallbackFunction("Gameclock", Event_GameClock, "Modifies settings for the game clock");
+	SubscribeEventCallbackFunction("LightingStressTest", Event_LightingStressTest, "Makes random block edits and verifies the resulting lighting");
+	SubscribeEventCallbackFunction("ChunkCodecBenchmark", Event_ChunkCodecBenchmark, "Measures chunk file sizes and encode/decode throughput");
 }
 
 Game::~Game()
@@ -93,6 +139,7 @@ void Game::Update()
 	{
 		case GameState::INTRO:					UpdateIntroScreen(deltaSeconds);				break;
 		case GameState::ATTRACT:				UpdateAttractScreen(deltaSeconds);				break;
+		case GameState::LOADING:				UpdateLoadingScreen(deltaSeconds);				break;
 		case GameState::GAME:					UpdateGame(deltaSeconds);						break;
 	}
 
@@ -199,7 +246,8 @@ void Game::UpdateKeyboardInput()
 	if (g_input->WasKeyJustPressed(KEYCODE_F8))
 	{
 		delete m_world;
-		m_world = new World(this);
+		CreateWorld();
+		return;
 	}
 
 	if (g_input->IsKeyDown('W'))
@@ -367,6 +415,7 @@ void Game::UpdateKeyboardInput()
 
 	DebugAddMessage(Stringf("Selected Block: %s", BlockDefinition::s_blockDefs[m_selectedBlockType].m_name.c_str()), 0.f, Rgba8::MAGENTA, Rgba8::MAGENTA);
 	DebugAddMessage(Stringf("Chunks: %d; Vertexes: %d", (int)m_world->m_activeChunks.size(), m_world->m_totalRenderedVerts), 0.f, Rgba8::CYAN, Rgba8::CYAN);
+	DebugAddMessage(Stringf("Compressed chunks: %d; Block memory: %d KB", m_world->m_numCompressedChunks, m_world->m_residentBlockBytes / 1024), 0.f, Rgba8::CYAN, Rgba8::CYAN);
 	DebugAddMessage("T = Slow; F8 = Recreate world", 0.f, Rgba8::YELLOW, Rgba8::YELLOW);
 	DebugAddMessage("WASD = Move in XY plane; QE = Groundward/Skyward; Shift (Hold) = Sprint", 0.f, Rgba8::YELLOW, Rgba8::WHITE);
 
@@ -578,6 +627,7 @@ void Game::ClearScreen() const
 	{
 		case GameState::INTRO:
 		case GameState::ATTRACT:
+		case GameState::LOADING:
 		{
 			g_renderer->ClearScreen(Rgba8::BLACK);
 			break;
@@ -596,6 +646,10 @@ void Game::RenderScreen() const
 	{
 		RenderAttractScreen();
 	}
+	else if (m_gameState == GameState::LOADING)
+	{
+		RenderLoadingScreen();
+	}
 }
 
 void Game::RenderGame() const
@@ -713,10 +767,7 @@ void Game::RenderGame() const
 
 void Game::StartGame()
 {
-	m_gameState = GameState::GAME;
-	m_timeInState = 0.f;
-
-	m_world = new World(this);
+	CreateWorld();
 
 	DebugAddWorldArrow(Vec3::ZERO, Vec3::EAST * 1.5f, 0.05f, -1.f, Rgba8::RED);
 	DebugAddWorldText("x- Forward", Mat44(Vec3::SOUTH, Vec3::EAST, Vec3::SKYWARD, Vec3(0.6f, 0.f, 0.15f)), 0.1f, Vec2(0.5f, 0.5f), -1.f, Rgba8::RED);
@@ -726,6 +777,15 @@ void Game::StartGame()
 	DebugAddWorldText("Z- Up", Mat44(Vec3::EAST, Vec3::SKYWARD, Vec3::NORTH, Vec3(0.f, -0.15f, 0.5f)), 0.1f, Vec2(0.5f, 0.5f), -1.f, Rgba8::BLUE);
 }
 
+void Game::CreateWorld()
+{
+	m_gameState = GameState::LOADING;
+	m_timeInState = 0.f;
+
+	m_world = new World(this);
+	m_world->BeginPregeneration();
+}
+
 void Game::QuitToAttractScreen()
 {
 	m_gameState = GameState::ATTRACT;
@@ -783,6 +843,36 @@ void Game::UpdateAttractScreen(float deltaSeconds)
 	UpdateCameras(deltaSeconds);
 }
 
+void Game::UpdateLoadingScreen(float deltaSeconds)
+{
+	m_timeInState += deltaSeconds;
+
+	// Deleting the world waits for any jobs still working on its chunks, so loading can be abandoned at any point
+	if (g_input->WasKeyJustPressed(KEYCODE_ESC))
+	{
+		QuitToAttractScreen();
+		return;
+	}
+	if (g_input->WasKeyJustPressed(KEYCODE_F8))
+	{
+		delete m_world;
+		CreateWorld();
+		return;
+	}
+
+	if (m_world->UpdatePregeneration())
+	{
+		m_gameState = GameState::GAME;
+		m_timeInState = 0.f;
+	}
+	else
+	{
+		DebugAddMessage(m_world->m_pregenerationStatus, 0.f, Rgba8::WHITE, Rgba8::WHITE);
+	}
+
+	UpdateCameras(deltaSeconds);
+}
+
 void Game::RenderIntroScreen() const
 {
 	SpriteSheet logoSpriteSheet(m_logoTexture, IntVec2(15, 19));
@@ -828,3 +918,22 @@ void Game::RenderAttractScreen() const
 	g_renderer->BindShader(nullptr);
 	g_renderer->DrawVertexArray(attractVerts);
 }
+
+void Game::RenderLoadingScreen() const
+{
+	std::vector<Vertex_PCU> loadingVerts;
+	AABB2 progressBarBox(Vec2(SCREEN_SIZE_X * 0.2f, SCREEN_SIZE_Y * 0.45f), Vec2(SCREEN_SIZE_X * 0.8f, SCREEN_SIZE_Y * 0.55f));
+	AABB2 progressFillBox = progressBarBox;
+	progressFillBox.m_maxs.x = RangeMap(m_world->m_pregenerationProgress, 0.f, 1.f, progressBarBox.m_mins.x, progressBarBox.m_maxs.x);
+	AddVertsForAABB2(loadingVerts, progressBarBox, Rgba8(64, 64, 64, 255));
+	AddVertsForAABB2(loadingVerts, progressFillBox, Rgba8::GREEN);
+	g_renderer->SetBlendMode(BlendMode::ALPHA);
+	g_renderer->SetDepthMode(DepthMode::DISABLED);
+	g_renderer->SetModelConstants();
+	g_renderer->SetRasterizerCullMode(RasterizerCullMode::CULL_NONE);
+	g_renderer->SetRasterizerFillMode(RasterizerFillMode::SOLID);
+	g_renderer->SetSamplerMode(SamplerMode::POINT_CLAMP);
+	g_renderer->BindTexture(nullptr);
+	g_renderer->BindShader(nullptr);
+	g_renderer->DrawVertexArray(loadingVerts);
+}
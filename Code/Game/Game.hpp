@@ -22,6 +22,7 @@ enum class GameState
 {
 	INTRO,
 	ATTRACT,
+	LOADING,
 	GAME
 };
 
@@ -37,8 +38,11 @@ public:
 
 	void						StartGame											();
 	void						QuitToAttractScreen									();
+	void						CreateWorld											();
 	
 	static bool					Event_GameClock										(EventArgs& args);
+	static bool					Event_LightingStressTest							(EventArgs& args);
+	static bool					Event_ChunkCodecBenchmark							(EventArgs& args);
 
 public:	
 	static constexpr float SCREEN_QUAD_DISTANCE = 2.f;
@@ -75,6 +79,7 @@ private:
 
 	void						UpdateIntroScreen									(float deltaSeconds);
 	void						UpdateAttractScreen									(float deltaSeconds);
+	void						UpdateLoadingScreen									(float deltaSeconds);
 	void						UpdateGame											(float deltaSeconds);	
 
 	void						HandleDeveloperCheats								();
@@ -89,6 +94,7 @@ private:
 
 	void						RenderIntroScreen									() const;
 	void						RenderAttractScreen									() const;
+	void						RenderLoadingScreen									() const;
 	void						RenderGame											() const;
 
 	void						LoadAssets											();
@@ -24,7 +24,6 @@
 #include "Engine/Renderer/Spritesheet.hpp"
 
 class App;
-struct Block;
 
 extern App*							g_app;
 extern RandomNumberGenerator*		g_RNG;
@@ -0,0 +1,174 @@
+#include "Game/PaletteArray.hpp"
+
+#include <cstring>
+
+
+void PaletteArray::Pack(uint8_t const* values, int numValues)
+{
+	Clear();
+	m_numValues = numValues;
+
+	int paletteIndexes[256];
+	for (int value = 0; value < 256; value++)
+	{
+		paletteIndexes[value] = -1;
+	}
+
+	for (int valueIndex = 0; valueIndex < numValues; valueIndex++)
+	{
+		uint8_t value = values[valueIndex];
+		if (paletteIndexes[value] == -1)
+		{
+			paletteIndexes[value] = (int)m_palette.size();
+			m_palette.push_back(value);
+		}
+	}
+
+	m_bitsPerValue = GetBitsPerValueForPaletteSize((int)m_palette.size());
+	if (m_bitsPerValue == 0)
+	{
+		return;
+	}
+
+	int valuesPerWord = 32 / m_bitsPerValue;
+	m_packedIndexes.resize((numValues + valuesPerWord - 1) / valuesPerWord, 0);
+	for (int valueIndex = 0; valueIndex < numValues; valueIndex++)
+	{
+		uint32_t paletteIndex = (uint32_t)paletteIndexes[values[valueIndex]];
+		m_packedIndexes[valueIndex / valuesPerWord] |= paletteIndex << ((valueIndex % valuesPerWord) * m_bitsPerValue);
+	}
+}
+
+void PaletteArray::Unpack(uint8_t* out_values) const
+{
+	if (m_palette.empty())
+	{
+		return;
+	}
+
+	if (m_bitsPerValue == 0)
+	{
+		memset(out_values, m_palette[0], m_numValues);
+		return;
+	}
+
+	int valuesPerWord = 32 / m_bitsPerValue;
+	uint32_t indexBitmask = (1u << m_bitsPerValue) - 1;
+	int valueIndex = 0;
+	for (int wordIndex = 0; wordIndex < (int)m_packedIndexes.size(); wordIndex++)
+	{
+		uint32_t word = m_packedIndexes[wordIndex];
+		for (int indexInWord = 0; indexInWord < valuesPerWord && valueIndex < m_numValues; indexInWord++, valueIndex++)
+		{
+			out_values[valueIndex] = m_palette[word & indexBitmask];
+			word >>= m_bitsPerValue;
+		}
+	}
+}
+
+void PaletteArray::Clear()
+{
+	m_palette.clear();
+	m_packedIndexes.clear();
+	m_bitsPerValue = 0;
+	m_numValues = 0;
+}
+
+void PaletteArray::WriteToBuffer(std::vector<uint8_t>& buffer) const
+{
+	// The palette size is stored minus one, so that all 256 values fit in a byte; the index width follows from it
+	buffer.push_back((uint8_t)(m_palette.size() - 1));
+	buffer.insert(buffer.end(), m_palette.begin(), m_palette.end());
+	for (int wordIndex = 0; wordIndex < (int)m_packedIndexes.size(); wordIndex++)
+	{
+		uint32_t word = m_packedIndexes[wordIndex];
+		buffer.push_back((uint8_t)(word));
+		buffer.push_back((uint8_t)(word >> 8));
+		buffer.push_back((uint8_t)(word >> 16));
+		buffer.push_back((uint8_t)(word >> 24));
+	}
+}
+
+bool PaletteArray::ReadFromBuffer(uint8_t const* data, size_t dataSize, size_t& readIndex, int numValues)
+{
+	Clear();
+	if (readIndex >= dataSize || numValues <= 0)
+	{
+		return false;
+	}
+
+	int paletteSize = data[readIndex] + 1;
+	readIndex++;
+	int bitsPerValue = GetBitsPerValueForPaletteSize(paletteSize);
+	int numWords = 0;
+	if (bitsPerValue > 0)
+	{
+		int valuesPerWord = 32 / bitsPerValue;
+		numWords = (numValues + valuesPerWord - 1) / valuesPerWord;
+	}
+	if (readIndex + paletteSize + (size_t)numWords * 4 > dataSize)
+	{
+		return false;
+	}
+
+	m_palette.assign(data + readIndex, data + readIndex + paletteSize);
+	readIndex += paletteSize;
+	m_packedIndexes.resize(numWords);
+	for (int wordIndex = 0; wordIndex < numWords; wordIndex++, readIndex += 4)
+	{
+		m_packedIndexes[wordIndex] = (uint32_t)data[readIndex] | ((uint32_t)data[readIndex + 1] << 8) | ((uint32_t)data[readIndex + 2] << 16) | ((uint32_t)data[readIndex + 3] << 24);
+	}
+	m_bitsPerValue = bitsPerValue;
+	m_numValues = numValues;
+
+	// Indexes past the end of the palette can only come from a corrupt buffer, and Unpack does not check for them
+	if (bitsPerValue > 0 && paletteSize < (1 << bitsPerValue))
+	{
+		int valuesPerWord = 32 / bitsPerValue;
+		uint32_t indexBitmask = (1u << bitsPerValue) - 1;
+		for (int valueIndex = 0; valueIndex < numValues; valueIndex++)
+		{
+			uint32_t paletteIndex = (m_packedIndexes[valueIndex / valuesPerWord] >> ((valueIndex % valuesPerWord) * bitsPerValue)) & indexBitmask;
+			if ((int)paletteIndex >= paletteSize)
+			{
+				Clear();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+int PaletteArray::GetNumBytes() const
+{
+	return (int)(m_palette.capacity() * sizeof(uint8_t) + m_packedIndexes.capacity() * sizeof(uint32_t));
+}
+
+int PaletteArray::GetBitsPerValue() const
+{
+	return m_bitsPerValue;
+}
+
+int PaletteArray::GetBitsPerValueForPaletteSize(int paletteSize)
+{
+	// Only power-of-two widths are used so that an index never straddles two words
+	if (paletteSize <= 1)
+	{
+		return 0;
+	}
+	else if (paletteSize <= 2)
+	{
+		return 1;
+	}
+	else if (paletteSize <= 4)
+	{
+		return 2;
+	}
+	else if (paletteSize <= 16)
+	{
+		return 4;
+	}
+
+	return 8;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+//--------------------------------------------------------------------------------
+// Compact copy of an array of bytes, stored as indexes into a palette of the distinct values
+// Indexes are bit-packed at 0, 1, 2, 4 or 8 bits each depending on the palette size,
+// so an array holding a single value costs only its palette entry
+class PaletteArray
+{
+public:
+	~PaletteArray() = default;
+	PaletteArray() = default;
+
+	void Pack(uint8_t const* values, int numValues);
+	void Unpack(uint8_t* out_values) const;
+	void Clear();
+	void WriteToBuffer(std::vector<uint8_t>& buffer) const;
+	bool ReadFromBuffer(uint8_t const* data, size_t dataSize, size_t& readIndex, int numValues);
+	int GetNumBytes() const;
+	int GetBitsPerValue() const;
+
+	static int GetBitsPerValueForPaletteSize(int paletteSize);
+
+private:
+	std::vector<uint8_t> m_palette;
+	std::vector<uint32_t> m_packedIndexes;
+	int m_bitsPerValue = 0;
+	int m_numValues = 0;
+};
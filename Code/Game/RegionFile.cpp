@@ -0,0 +1,427 @@
+#include "Game/RegionFile.hpp"
+
+#include "Game/GameCommon.hpp"
+
+#include "Engine/Core/DevConsole.hpp"
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+#include <cstring>
+
+
+static void WriteUint32(uint8_t* bytes, uint32_t value)
+{
+	bytes[0] = (uint8_t)(value);
+	bytes[1] = (uint8_t)(value >> 8);
+	bytes[2] = (uint8_t)(value >> 16);
+	bytes[3] = (uint8_t)(value >> 24);
+}
+
+static uint32_t ReadUint32(uint8_t const* bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+
+RegionFile::~RegionFile()
+{
+	std::lock_guard<std::mutex> regionLock(m_mutex);
+	UnmapFile();
+	if (m_nativeFileHandle)
+	{
+		CloseHandle((HANDLE)m_nativeFileHandle);
+		m_nativeFileHandle = nullptr;
+	}
+	if (m_file.is_open())
+	{
+		m_file.close();
+	}
+}
+
+RegionFile::RegionFile(std::string const& filePath)
+	: m_filePath(filePath)
+{
+	Open();
+}
+
+bool RegionFile::ReadChunk(IntVec2 const& chunkCoords, std::vector<uint8_t>& out_chunkData)
+{
+	std::lock_guard<std::mutex> regionLock(m_mutex);
+
+	int chunkIndex = GetChunkIndexInRegion(chunkCoords);
+	if (m_chunkFirstSectors[chunkIndex] == 0 || !m_file.is_open())
+	{
+		return false;
+	}
+
+	out_chunkData.resize(m_chunkNumBytes[chunkIndex]);
+	if (IsChunkMapped(chunkIndex))
+	{
+		memcpy(out_chunkData.data(), m_mappedData + (size_t)m_chunkFirstSectors[chunkIndex] * REGION_SECTOR_SIZE, out_chunkData.size());
+		return true;
+	}
+
+	m_file.clear();
+	m_file.seekg((std::streamoff)m_chunkFirstSectors[chunkIndex] * REGION_SECTOR_SIZE);
+	m_file.read((char*)out_chunkData.data(), (std::streamsize)out_chunkData.size());
+	if (!m_file)
+	{
+		g_console->AddLine(Stringf("Could not read chunk (%d, %d) from region file %s", chunkCoords.x, chunkCoords.y, m_filePath.c_str()));
+		out_chunkData.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool RegionFile::WriteChunk(IntVec2 const& chunkCoords, std::vector<uint8_t> const& chunkData)
+{
+	std::lock_guard<std::mutex> regionLock(m_mutex);
+
+	if (!m_file.is_open())
+	{
+		return false;
+	}
+
+	int chunkIndex = GetChunkIndexInRegion(chunkCoords);
+	int numSectors = GetMax(((int)chunkData.size() + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, 1);
+	int oldFirstSector = (int)m_chunkFirstSectors[chunkIndex];
+	int oldNumSectors = (oldFirstSector == 0) ? 0 : GetMax(((int)m_chunkNumBytes[chunkIndex] + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, 1);
+
+	// The new copy never overlaps the old one, and it is on disk before the header entry points at it,
+	// so a crash or power loss before the header entry is updated still leaves the old chunk intact
+	int firstSector = AllocateSectors(numSectors);
+	if (!ReserveSectors(firstSector + numSectors))
+	{
+		SetSectorsUsed(firstSector, numSectors, false);
+		g_console->AddLine(Stringf("Could not grow region file %s for chunk (%d, %d)", m_filePath.c_str(), chunkCoords.x, chunkCoords.y));
+		return false;
+	}
+
+	// Sectors are written whole so that the file always ends on a sector boundary
+	std::vector<uint8_t> sectorData(chunkData);
+	sectorData.resize((size_t)numSectors * REGION_SECTOR_SIZE, 0);
+
+	m_file.clear();
+	m_file.seekp((std::streamoff)firstSector * REGION_SECTOR_SIZE);
+	m_file.write((char const*)sectorData.data(), (std::streamsize)sectorData.size());
+	if (!SyncToDisk())
+	{
+		SetSectorsUsed(firstSector, numSectors, false);
+		g_console->AddLine(Stringf("Could not write chunk (%d, %d) to region file %s", chunkCoords.x, chunkCoords.y, m_filePath.c_str()));
+		return false;
+	}
+
+	// Committing is a single 8-byte header entry write; the old sectors only become reusable once it is on disk
+	m_chunkFirstSectors[chunkIndex] = (uint32_t)firstSector;
+	m_chunkNumBytes[chunkIndex] = (uint32_t)chunkData.size();
+	WriteHeaderEntry(chunkIndex);
+	if (!SyncToDisk())
+	{
+		g_console->AddLine(Stringf("Could not write chunk (%d, %d) to region file %s", chunkCoords.x, chunkCoords.y, m_filePath.c_str()));
+		return false;
+	}
+
+	SetSectorsUsed(oldFirstSector, oldNumSectors, false);
+	return true;
+}
+
+void RegionFile::PrefetchChunk(IntVec2 const& chunkCoords)
+{
+	std::lock_guard<std::mutex> regionLock(m_mutex);
+
+	int chunkIndex = GetChunkIndexInRegion(chunkCoords);
+	if (m_chunkFirstSectors[chunkIndex] == 0 || !IsChunkMapped(chunkIndex))
+	{
+		return;
+	}
+
+	// Reading one byte per page is enough to fault the whole chunk into the page cache
+	uint8_t const* chunkData = m_mappedData + (size_t)m_chunkFirstSectors[chunkIndex] * REGION_SECTOR_SIZE;
+	volatile uint8_t touchedByte = 0;
+	for (uint32_t byteIndex = 0; byteIndex < m_chunkNumBytes[chunkIndex]; byteIndex += REGION_SECTOR_SIZE)
+	{
+		touchedByte = touchedByte + chunkData[byteIndex];
+	}
+}
+
+bool RegionFile::ReadStoredChunkCoords(std::string const& filePath, IntVec2 const& regionCoords, std::vector<IntVec2>& out_chunkCoords)
+{
+	// Only the header is read, through a stream that is closed again, so scanning a save folder keeps no region open or mapped
+	std::ifstream file(filePath, std::ios::in | std::ios::binary);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::vector<uint8_t> header(REGION_HEADER_SIZE);
+	file.read((char*)header.data(), REGION_HEADER_SIZE);
+	bool isHeaderValid = file && header[0] == 'G' && header[1] == 'R' && header[2] == 'G' && header[3] == 'N' && header[4] == REGION_FILE_VERSION && header[5] == REGION_BITS;
+	if (!isHeaderValid)
+	{
+		return false;
+	}
+
+	file.seekg(0, std::ios::end);
+	int numFileSectors = (int)(((int64_t)file.tellg() + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE);
+
+	for (int chunkIndex = 0; chunkIndex < REGION_NUM_CHUNKS; chunkIndex++)
+	{
+		uint8_t const* headerEntry = &header[REGION_HEADER_ENTRIES_OFFSET + chunkIndex * REGION_HEADER_ENTRY_SIZE];
+		uint32_t firstSector = ReadUint32(headerEntry);
+		int numSectors = GetMax(((int)ReadUint32(headerEntry + 4) + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, 1);
+		if (firstSector == 0 || (int)firstSector < REGION_HEADER_SECTORS || (int)firstSector + numSectors > numFileSectors)
+		{
+			continue;
+		}
+
+		out_chunkCoords.push_back(IntVec2(regionCoords.x * REGION_SIZE + (chunkIndex & REGION_BITMASK), regionCoords.y * REGION_SIZE + (chunkIndex >> REGION_BITS)));
+	}
+	return true;
+}
+
+IntVec2 RegionFile::GetRegionCoordsForChunk(IntVec2 const& chunkCoords)
+{
+	// Arithmetic shifts round towards negative infinity, so negative chunk coordinates map to the correct region
+	return IntVec2(chunkCoords.x >> REGION_BITS, chunkCoords.y >> REGION_BITS);
+}
+
+int RegionFile::GetChunkIndexInRegion(IntVec2 const& chunkCoords)
+{
+	return (chunkCoords.x & REGION_BITMASK) | ((chunkCoords.y & REGION_BITMASK) << REGION_BITS);
+}
+
+void RegionFile::Open()
+{
+	m_file.open(m_filePath, std::ios::in | std::ios::out | std::ios::binary);
+	if (!m_file.is_open())
+	{
+		CreateEmpty();
+		return;
+	}
+
+	std::vector<uint8_t> header(REGION_HEADER_SIZE);
+	m_file.read((char*)header.data(), REGION_HEADER_SIZE);
+	bool isHeaderValid = m_file && header[0] == 'G' && header[1] == 'R' && header[2] == 'G' && header[3] == 'N' && header[4] == REGION_FILE_VERSION && header[5] == REGION_BITS;
+	if (!isHeaderValid)
+	{
+		g_console->AddLine(Stringf("Invalid region file %s. File will be recreated!", m_filePath.c_str()));
+		m_file.close();
+		CreateEmpty();
+		return;
+	}
+
+	m_file.clear();
+	m_file.seekg(0, std::ios::end);
+	int numFileSectors = (int)(((int64_t)m_file.tellg() + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE);
+	m_numFileSectors = GetMax(numFileSectors, REGION_HEADER_SECTORS);
+	m_usedSectors.assign(m_numFileSectors, false);
+	SetSectorsUsed(0, REGION_HEADER_SECTORS, true);
+
+	for (int chunkIndex = 0; chunkIndex < REGION_NUM_CHUNKS; chunkIndex++)
+	{
+		uint8_t const* headerEntry = &header[REGION_HEADER_ENTRIES_OFFSET + chunkIndex * REGION_HEADER_ENTRY_SIZE];
+		uint32_t firstSector = ReadUint32(headerEntry);
+		uint32_t numBytes = ReadUint32(headerEntry + 4);
+		int numSectors = GetMax(((int)numBytes + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE, 1);
+		if (firstSector == 0)
+		{
+			continue;
+		}
+		if ((int)firstSector < REGION_HEADER_SECTORS || (int)firstSector + numSectors > numFileSectors)
+		{
+			g_console->AddLine(Stringf("Chunk %d in region file %s points outside the file and will be ignored", chunkIndex, m_filePath.c_str()));
+			continue;
+		}
+
+		m_chunkFirstSectors[chunkIndex] = firstSector;
+		m_chunkNumBytes[chunkIndex] = numBytes;
+		SetSectorsUsed((int)firstSector, numSectors, true);
+	}
+}
+
+void RegionFile::CreateEmpty()
+{
+	std::vector<uint8_t> header((size_t)REGION_HEADER_SECTORS * REGION_SECTOR_SIZE, 0);
+	header[0] = 'G';
+	header[1] = 'R';
+	header[2] = 'G';
+	header[3] = 'N';
+	header[4] = (uint8_t)REGION_FILE_VERSION;
+	header[5] = (uint8_t)REGION_BITS;
+
+	m_file.open(m_filePath, std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc);
+	if (!m_file.is_open())
+	{
+		g_console->AddLine(Stringf("Could not create region file %s", m_filePath.c_str()));
+		return;
+	}
+
+	m_file.write((char const*)header.data(), (std::streamsize)header.size());
+	m_file.flush();
+
+	for (int chunkIndex = 0; chunkIndex < REGION_NUM_CHUNKS; chunkIndex++)
+	{
+		m_chunkFirstSectors[chunkIndex] = 0;
+		m_chunkNumBytes[chunkIndex] = 0;
+	}
+	m_usedSectors.assign(REGION_HEADER_SECTORS, true);
+	m_numFileSectors = REGION_HEADER_SECTORS;
+}
+
+void RegionFile::WriteHeaderEntry(int chunkIndex)
+{
+	uint8_t headerEntry[REGION_HEADER_ENTRY_SIZE];
+	WriteUint32(headerEntry, m_chunkFirstSectors[chunkIndex]);
+	WriteUint32(headerEntry + 4, m_chunkNumBytes[chunkIndex]);
+
+	m_file.seekp(REGION_HEADER_ENTRIES_OFFSET + chunkIndex * REGION_HEADER_ENTRY_SIZE);
+	m_file.write((char const*)headerEntry, REGION_HEADER_ENTRY_SIZE);
+}
+
+bool RegionFile::OpenNativeHandle()
+{
+	// Writes go through m_file; a second, native handle is mapped for reads (which see writes as soon as they are flushed) and used to sync the file
+	if (!m_nativeFileHandle)
+	{
+		HANDLE nativeFileHandle = CreateFileA(m_filePath.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (nativeFileHandle == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		m_nativeFileHandle = nativeFileHandle;
+	}
+	return true;
+}
+
+bool RegionFile::SyncToDisk()
+{
+	// Flushing the stream only hands its bytes to the OS cache; FlushFileBuffers waits until they are on the disk itself
+	m_file.flush();
+	if (!m_file || !OpenNativeHandle())
+	{
+		return false;
+	}
+	return FlushFileBuffers((HANDLE)m_nativeFileHandle) != 0;
+}
+
+bool RegionFile::MapFile()
+{
+	UnmapFile();
+
+	if (!OpenNativeHandle())
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx((HANDLE)m_nativeFileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		return false;
+	}
+
+	HANDLE fileMappingHandle = CreateFileMappingA((HANDLE)m_nativeFileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!fileMappingHandle)
+	{
+		return false;
+	}
+
+	void* mappedData = MapViewOfFile(fileMappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (!mappedData)
+	{
+		CloseHandle(fileMappingHandle);
+		return false;
+	}
+
+	m_fileMappingHandle = fileMappingHandle;
+	m_mappedData = (uint8_t const*)mappedData;
+	m_mappedSize = (size_t)fileSize.QuadPart;
+	return true;
+}
+
+void RegionFile::UnmapFile()
+{
+	if (m_mappedData)
+	{
+		UnmapViewOfFile(m_mappedData);
+		m_mappedData = nullptr;
+	}
+	if (m_fileMappingHandle)
+	{
+		CloseHandle((HANDLE)m_fileMappingHandle);
+		m_fileMappingHandle = nullptr;
+	}
+	m_mappedSize = 0;
+}
+
+bool RegionFile::IsChunkMapped(int chunkIndex)
+{
+	// The mapping covers the whole file including its reserved free sectors, so it is only recreated after the file has doubled
+	size_t chunkEnd = (size_t)m_chunkFirstSectors[chunkIndex] * REGION_SECTOR_SIZE + m_chunkNumBytes[chunkIndex];
+	if (chunkEnd <= m_mappedSize)
+	{
+		return true;
+	}
+
+	return MapFile() && chunkEnd <= m_mappedSize;
+}
+
+int RegionFile::AllocateSectors(int numSectors)
+{
+	int numFreeSectorsInRun = 0;
+	for (int sectorIndex = REGION_HEADER_SECTORS; sectorIndex < (int)m_usedSectors.size(); sectorIndex++)
+	{
+		numFreeSectorsInRun = m_usedSectors[sectorIndex] ? 0 : numFreeSectorsInRun + 1;
+		if (numFreeSectorsInRun == numSectors)
+		{
+			int firstSector = sectorIndex - numSectors + 1;
+			SetSectorsUsed(firstSector, numSectors, true);
+			return firstSector;
+		}
+	}
+
+	// No gap is large enough, so the chunk is appended (reusing any free sectors at the very end of the file)
+	int firstSector = (int)m_usedSectors.size() - numFreeSectorsInRun;
+	SetSectorsUsed(firstSector, numSectors, true);
+	return firstSector;
+}
+
+bool RegionFile::ReserveSectors(int numSectors)
+{
+	if (numSectors <= m_numFileSectors)
+	{
+		return true;
+	}
+
+	// Trailing sectors nothing uses yet are found as free by AllocateSectors, both now and after the file is opened again
+	int newNumFileSectors = GetMax(numSectors, m_numFileSectors * 2);
+	m_file.clear();
+	m_file.seekp((std::streamoff)newNumFileSectors * REGION_SECTOR_SIZE - 1);
+	m_file.put(0);
+	m_file.flush();
+	if (!m_file)
+	{
+		return false;
+	}
+
+	m_numFileSectors = newNumFileSectors;
+	if ((int)m_usedSectors.size() < m_numFileSectors)
+	{
+		m_usedSectors.resize(m_numFileSectors, false);
+	}
+	return true;
+}
+
+void RegionFile::SetSectorsUsed(int firstSector, int numSectors, bool isUsed)
+{
+	if (firstSector + numSectors > (int)m_usedSectors.size())
+	{
+		m_usedSectors.resize(firstSector + numSectors, false);
+	}
+
+	for (int sectorIndex = firstSector; sectorIndex < firstSector + numSectors; sectorIndex++)
+	{
+		m_usedSectors[sectorIndex] = isUsed;
+	}
+}
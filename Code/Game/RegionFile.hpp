@@ -0,0 +1,71 @@
+#pragma once
+
+#include "Engine/Math/IntVec2.hpp"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+constexpr int REGION_BITS = 5;
+constexpr int REGION_SIZE = 1 << REGION_BITS;
+constexpr int REGION_BITMASK = REGION_SIZE - 1;
+constexpr int REGION_NUM_CHUNKS = REGION_SIZE * REGION_SIZE;
+
+constexpr int REGION_FILE_VERSION = 1;
+constexpr int REGION_SECTOR_SIZE = 4096;
+constexpr int REGION_HEADER_ENTRIES_OFFSET = 8;
+constexpr int REGION_HEADER_ENTRY_SIZE = 8;
+constexpr int REGION_HEADER_SIZE = REGION_HEADER_ENTRIES_OFFSET + REGION_NUM_CHUNKS * REGION_HEADER_ENTRY_SIZE;
+constexpr int REGION_HEADER_SECTORS = (REGION_HEADER_SIZE + REGION_SECTOR_SIZE - 1) / REGION_SECTOR_SIZE;
+
+
+//--------------------------------------------------------------------------------
+// Stores the files of REGION_SIZE x REGION_SIZE chunks in one file that stays open while the region is in use
+// The header holds a (first sector, byte count) entry per chunk; chunk data lives in whole 4 KB sectors after it
+// Chunks are written copy-on-write: new data goes to the first free run of sectors (or the end of the file) and is synced to disk before the header entry is switched over
+// All functions lock the region, so chunks of the same region may be read and written from different threads
+// Reads go through a read-only mapping of the file, so chunks the read-ahead has already touched are copied straight out of the page cache
+// The file is grown by doubling, with free sectors at its end, so appending chunks only rarely forces the mapping to be recreated
+class RegionFile
+{
+public:
+	~RegionFile();
+	explicit RegionFile(std::string const& filePath);
+
+	bool ReadChunk(IntVec2 const& chunkCoords, std::vector<uint8_t>& out_chunkData);
+	bool WriteChunk(IntVec2 const& chunkCoords, std::vector<uint8_t> const& chunkData);
+	void PrefetchChunk(IntVec2 const& chunkCoords);
+
+	static bool ReadStoredChunkCoords(std::string const& filePath, IntVec2 const& regionCoords, std::vector<IntVec2>& out_chunkCoords);
+	static IntVec2 GetRegionCoordsForChunk(IntVec2 const& chunkCoords);
+	static int GetChunkIndexInRegion(IntVec2 const& chunkCoords);
+
+private:
+	void Open();
+	void CreateEmpty();
+	void WriteHeaderEntry(int chunkIndex);
+	bool OpenNativeHandle();
+	bool SyncToDisk();
+	bool MapFile();
+	void UnmapFile();
+	bool IsChunkMapped(int chunkIndex);
+	int AllocateSectors(int numSectors);
+	bool ReserveSectors(int numSectors);
+	void SetSectorsUsed(int firstSector, int numSectors, bool isUsed);
+
+private:
+	std::string m_filePath;
+	std::fstream m_file;
+	std::mutex m_mutex;
+	uint32_t m_chunkFirstSectors[REGION_NUM_CHUNKS] = {};
+	uint32_t m_chunkNumBytes[REGION_NUM_CHUNKS] = {};
+	std::vector<bool> m_usedSectors;
+	int m_numFileSectors = 0;
+	void* m_nativeFileHandle = nullptr;
+	void* m_fileMappingHandle = nullptr;
+	uint8_t const* m_mappedData = nullptr;
+	size_t m_mappedSize = 0;
+};
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vector>
+
+
+//--------------------------------------------------------------------------------
+// FIFO queue over a single power-of-two sized allocation
+// Storage is only ever grown (doubling), so once a queue has warmed up, pushing and popping never allocate
+// Release gives the storage back when a queue is known to stay idle; the next push starts growing it again
+template <typename T>
+class RingBuffer
+{
+public:
+	~RingBuffer() = default;
+	RingBuffer() = default;
+	explicit RingBuffer(int initialCapacity);
+
+	void Push(T const& element);
+	T Pop();
+	T const& Front() const;
+	bool IsEmpty() const;
+	int GetSize() const;
+	int GetCapacity() const;
+	void Clear();
+	void Release();
+
+private:
+	void Grow();
+
+private:
+	std::vector<T> m_elements;
+	int m_head = 0;
+	int m_size = 0;
+};
+
+
+template <typename T>
+RingBuffer<T>::RingBuffer(int initialCapacity)
+{
+	int capacity = 1;
+	while (capacity < initialCapacity)
+	{
+		capacity <<= 1;
+	}
+	m_elements.resize(capacity);
+}
+
+template <typename T>
+void RingBuffer<T>::Push(T const& element)
+{
+	if (m_size == (int)m_elements.size())
+	{
+		Grow();
+	}
+
+	int tail = (m_head + m_size) & ((int)m_elements.size() - 1);
+	m_elements[tail] = element;
+	m_size++;
+}
+
+template <typename T>
+T RingBuffer<T>::Pop()
+{
+	T element = m_elements[m_head];
+	m_head = (m_head + 1) & ((int)m_elements.size() - 1);
+	m_size--;
+	return element;
+}
+
+template <typename T>
+T const& RingBuffer<T>::Front() const
+{
+	return m_elements[m_head];
+}
+
+template <typename T>
+bool RingBuffer<T>::IsEmpty() const
+{
+	return m_size == 0;
+}
+
+template <typename T>
+int RingBuffer<T>::GetSize() const
+{
+	return m_size;
+}
+
+template <typename T>
+int RingBuffer<T>::GetCapacity() const
+{
+	return (int)m_elements.size();
+}
+
+template <typename T>
+void RingBuffer<T>::Clear()
+{
+	m_head = 0;
+	m_size = 0;
+}
+
+template <typename T>
+void RingBuffer<T>::Release()
+{
+	std::vector<T>().swap(m_elements);
+	m_head = 0;
+	m_size = 0;
+}
+
+template <typename T>
+void RingBuffer<T>::Grow()
+{
+	int oldCapacity = (int)m_elements.size();
+	int newCapacity = (oldCapacity == 0) ? 16 : oldCapacity * 2;
+
+	// Unwrap the elements so that the queue starts at the front of the new storage
+	std::vector<T> elements(newCapacity);
+	for (int elementIndex = 0; elementIndex < m_size; elementIndex++)
+	{
+		elements[elementIndex] = m_elements[(m_head + elementIndex) & (oldCapacity - 1)];
+	}
+
+	m_elements.swap(elements);
+	m_head = 0;
+}
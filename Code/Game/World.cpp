@@ -5,37 +5,151 @@
 #include "Game/GameCommon.hpp"
 #include "Game/Block.hpp"
 #include "Game/BlockIter.hpp"
+#include "Game/BlockDefinition.hpp"
+#include "Game/RegionFile.hpp"
 
 #include "Engine/Core/DevConsole.hpp"
 #include "Engine/Core/FileUtils.hpp"
 #include "Engine/Core/Time.hpp"
 #include "ThirdParty/Squirrel/SmoothNoise.hpp"
 
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+
+
+constexpr int LIGHTING_MAX_STEPS_PER_CHUNK_PHASE = 4096;
+constexpr int CHUNK_MANIFEST_VERSION = 1;
+constexpr int SESSION_FILE_VERSION = 1;
+constexpr float PREGENERATION_ACTIVATION_PROGRESS = 0.7f;
+constexpr float PREGENERATION_LIGHTING_PROGRESS = 0.15f;
+constexpr int SESSION_FILE_HEADER_SIZE = 5 + 7 * 4 + 4;
+
+
+static void WriteUint32(std::vector<uint8_t>& buffer, uint32_t value)
+{
+	buffer.push_back((uint8_t)(value));
+	buffer.push_back((uint8_t)(value >> 8));
+	buffer.push_back((uint8_t)(value >> 16));
+	buffer.push_back((uint8_t)(value >> 24));
+}
+
+static uint32_t ReadUint32(uint8_t const* bytes)
+{
+	return (uint32_t)bytes[0] | ((uint32_t)bytes[1] << 8) | ((uint32_t)bytes[2] << 16) | ((uint32_t)bytes[3] << 24);
+}
+
+static void WriteSessionFloat(std::vector<uint8_t>& buffer, float value)
+{
+	uint32_t valueBits;
+	memcpy(&valueBits, &value, sizeof(valueBits));
+	WriteUint32(buffer, valueBits);
+}
+
+static float ReadSessionFloat(uint8_t const* bytes)
+{
+	uint32_t valueBits = ReadUint32(bytes);
+	float value;
+	memcpy(&value, &valueBits, sizeof(value));
+	return value;
+}
+
+// Parses names like "Region(-1,2).region" into their coordinates
+static bool ParseCoordsFromFileName(std::string const& fileName, std::string const& prefix, std::string const& suffix, IntVec2& out_coords)
+{
+	if (fileName.size() <= prefix.size() + suffix.size() || fileName.compare(0, prefix.size(), prefix) != 0 || fileName.compare(fileName.size() - suffix.size(), suffix.size(), suffix) != 0)
+	{
+		return false;
+	}
+
+	std::string coordsText = fileName.substr(prefix.size(), fileName.size() - prefix.size() - suffix.size());
+	char* coordsEnd = nullptr;
+	out_coords.x = (int)strtol(coordsText.c_str(), &coordsEnd, 10);
+	if (*coordsEnd != ',')
+	{
+		return false;
+	}
+	char const* yText = coordsEnd + 1;
+	out_coords.y = (int)strtol(yText, &coordsEnd, 10);
+	return coordsEnd != yText && *coordsEnd == '\0';
+}
+
 
 World::~World()
 {
+	// A world left while it was still pregenerating only has part of its chunks, so the previous session is kept as it was
+	if (m_isPregenerationComplete)
+	{
+		SaveSession();
+	}
+	WaitForChunkJobs();
+
 	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
 	{
 		Chunk*& chunk = chunkMapIter->second;
+		QueueChunkSave(chunk);
 		delete chunk;
 	}
 	m_activeChunks.clear();
 
-	m_chunkCoordsQueuedForActivation.clear();
+	FlushChunkSaves();
+	SaveChunkManifest();
+
+	for (int jobIndex = 0; jobIndex < (int)m_deferredCompletedJobs.size(); jobIndex++)
+	{
+		ChunkGenerateJob* generateJob = dynamic_cast<ChunkGenerateJob*>(m_deferredCompletedJobs[jobIndex]);
+		if (generateJob)
+		{
+			delete generateJob->m_chunk;
+		}
+		ChunkLoadJob* loadJob = dynamic_cast<ChunkLoadJob*>(m_deferredCompletedJobs[jobIndex]);
+		if (loadJob)
+		{
+			delete loadJob->m_chunk;
+		}
+		delete m_deferredCompletedJobs[jobIndex];
+	}
+	m_deferredCompletedJobs.clear();
 
 	g_jobSystem->Shutdown();
 	g_jobSystem->Startup();
+
+	// Every save has been flushed by now, so nothing can still be writing to the regions
+	for (auto regionFileMapIter = m_regionFiles.begin(); regionFileMapIter != m_regionFiles.end(); ++regionFileMapIter)
+	{
+		delete regionFileMapIter->second;
+	}
+	m_regionFiles.clear();
 }
 
 World::World(Game* game)
 	: m_game(game)
 {
 	m_worldSeed = g_gameConfigBlackboard.GetValue("worldSeed", m_worldSeed);
+	m_lightingBudgetMilliseconds = g_gameConfigBlackboard.GetValue("lightingBudgetMilliseconds", m_lightingBudgetMilliseconds);
+	m_saveChunkLighting = g_gameConfigBlackboard.GetValue("saveChunkLighting", m_saveChunkLighting);
+	m_savePackedChunkFiles = g_gameConfigBlackboard.GetValue("savePackedChunkFiles", m_savePackedChunkFiles);
+	m_regionReadAheadChunks = g_gameConfigBlackboard.GetValue("regionReadAheadChunks", m_regionReadAheadChunks);
+	m_spawnPregenerationRadius = g_gameConfigBlackboard.GetValue("spawnPregenerationRadius", g_activationRadius);
+	m_chunkCompressionIdleSeconds = g_gameConfigBlackboard.GetValue("chunkCompressionIdleSeconds", m_chunkCompressionIdleSeconds);
+	m_maxEditDeltaBlocks = std::min(g_gameConfigBlackboard.GetValue("maxEditDeltaBlocks", m_maxEditDeltaBlocks), (int)UINT16_MAX);
+	m_maxLightingChunksPerPhase = GetMax((int)std::thread::hardware_concurrency(), 1);
 	if (m_worldSeed == 0)
 	{
 		m_worldSeed = g_RNG->RollRandomIntLessThan(INT_MAX);
 	}
 
+	m_saveFilePath = Stringf("Saves/World_%u/", m_worldSeed);
+	CreateFolder(m_saveFilePath.c_str());
+	if (!LoadChunkManifest())
+	{
+		RebuildChunkManifest();
+	}
+	RestoreSession();
+
 	m_shader = g_renderer->CreateOrGetShader("Data/Shaders/World");
 	m_shaderConstants = g_renderer->CreateConstantBuffer(sizeof(SimpleMinerConstants));
 }
@@ -51,8 +165,14 @@ void World::Update()
 	m_worldTime += (deltaSeconds * m_worldTimeScale) / (60.f * 60.f * 24.f);
 
 	HandleChunkActivationDeactivation();
+	QueueChunkReadAhead();
 	m_totalRenderedVerts = 0;
 
+	if (!m_disableLighting)
+	{
+		ProcessDirtyLighting();
+	}
+
 	Chunk* nearestChunk = nullptr;
 	float nearestChunkDistance = FLT_MAX;
 	Chunk* secondNearestChunk = nullptr;
@@ -62,7 +182,7 @@ void World::Update()
 	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
 	{
 		Chunk* chunk = chunkMapIter->second;
-		if (!chunk->m_isCpuMeshDirty)
+		if (chunk->m_dirtyMeshSections == 0)
 		{
 			continue;
 		}
@@ -70,6 +190,11 @@ void World::Update()
 		{
 			continue;
 		}
+		if (chunk->HasDirtyLighting())
+		{
+			// Lighting is not settled yet, so any mesh built now would be rebuilt again shortly
+			continue;
+		}
 
 		Vec2 chunkCenterXY = chunk->m_worldPosition.GetXY();
 		float chunkDistance = GetDistance2D(m_game->m_cameraPosition.GetXY(), chunkCenterXY);
@@ -98,16 +223,14 @@ void World::Update()
 		secondNearestChunk->RebuildMesh();
 	}
 
+	CompressIdleChunk();
+
 	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
 	{
 		chunkMapIter->second->Update();
 	}
 
 	UpdateSimpleMinerShaderConstants();
-	if (!m_disableLighting)
-	{
-		ProcessDirtyLighting();
-	}
 
 	double worldUpdateEndTime = GetCurrentTimeSeconds();
 	g_worldUpdateTime = (worldUpdateEndTime - worldUpdateStartTime) * 1000.f;
@@ -204,27 +327,26 @@ void World::UpdateSimpleMinerShaderConstants()
 
 void World::RequestChunkActivation(IntVec2 const& chunkCoords)
 {
+	// Chunks that were never saved skip the file lookup entirely; the load job still generates if a listed file turns out to be unusable
 	Chunk* chunk = new Chunk(this, chunkCoords);
-
-	bool loaded = chunk->LoadFromFile();
-	if (loaded)
+	if (GetChunkState(chunkCoords) == ChunkState::ON_DISK)
 	{
-		ActivateChunk(chunk);
+		chunk->m_state = ChunkState::ACTIVATING_QUEUED_LOAD;
+		g_jobSystem->QueueJob(new ChunkLoadJob(chunk));
 	}
-	if (!loaded)
+	else
 	{
 		chunk->m_state = ChunkState::ACTIVATING_QUEUED_GENERATE;
-		ChunkGenerateJob* generateJob = new ChunkGenerateJob(chunk);
-		g_jobSystem->QueueJob(generateJob);
-		m_chunkCoordsQueuedForActivation.insert(chunkCoords);
+		g_jobSystem->QueueJob(new ChunkGenerateJob(chunk));
 	}
-
-	return;
+	m_chunkCoordsQueuedForActivation.insert(chunkCoords);
 }
 
 void World::DeactivateChunk(IntVec2 const& chunkCoords)
 {
 	m_activeChunks[chunkCoords]->m_state = ChunkState::DEACTIVATING_QUEUED_SAVE;
+	RemoveChunkFromLightingWorklist(m_activeChunks[chunkCoords]);
+	QueueChunkSave(m_activeChunks[chunkCoords]);
 	IntVec2 chunkCoordinates(chunkCoords);
 	delete m_activeChunks[chunkCoordinates];
 	m_activeChunks[chunkCoordinates] = nullptr;
@@ -251,16 +373,114 @@ void World::HandleChunkActivationDeactivation()
 		DeactivateFarthestChunkOutOfRange(0.f);
 	}
 
-	Job* completedJob = g_jobSystem->GetCompletedJob();
+	Job* completedJob = nullptr;
+	if (!m_deferredCompletedJobs.empty())
+	{
+		completedJob = m_deferredCompletedJobs.front();
+		m_deferredCompletedJobs.erase(m_deferredCompletedJobs.begin());
+	}
+	else
+	{
+		completedJob = g_jobSystem->GetCompletedJob();
+	}
+	HandleCompletedJob(completedJob);
+
+	double chunkActivationDeactivationDecisionEndTime = GetCurrentTimeSeconds();
+	g_chunkActivationDeactivationDecisionTime = (chunkActivationDeactivationDecisionEndTime - chunkActivationDeactivationDecisionStartTime) * 1000.f;
+}
+
+void World::HandleCompletedJob(Job* completedJob)
+{
 	ChunkGenerateJob* generateJob = dynamic_cast<ChunkGenerateJob*>(completedJob);
 	if (generateJob)
 	{
 		m_chunkCoordsQueuedForActivation.erase(generateJob->m_chunk->m_coords);
 		ActivateChunk(generateJob->m_chunk);
+		delete generateJob;
+		return;
 	}
 
-	double chunkActivationDeactivationDecisionEndTime = GetCurrentTimeSeconds();
-	g_chunkActivationDeactivationDecisionTime = (chunkActivationDeactivationDecisionEndTime - chunkActivationDeactivationDecisionStartTime) * 1000.f;
+	ChunkLoadJob* loadJob = dynamic_cast<ChunkLoadJob*>(completedJob);
+	if (loadJob)
+	{
+		m_chunkCoordsQueuedForActivation.erase(loadJob->m_chunk->m_coords);
+		ActivateChunk(loadJob->m_chunk);
+		delete loadJob;
+		return;
+	}
+
+	ChunkSaveJob* saveJob = dynamic_cast<ChunkSaveJob*>(completedJob);
+	if (saveJob)
+	{
+		delete saveJob;
+		return;
+	}
+
+	ChunkReadAheadJob* readAheadJob = dynamic_cast<ChunkReadAheadJob*>(completedJob);
+	if (readAheadJob)
+	{
+		delete readAheadJob;
+		return;
+	}
+
+	// Vertex buffers can only be created and filled on the main thread
+	ChunkMeshJob* meshJob = dynamic_cast<ChunkMeshJob*>(completedJob);
+	if (meshJob)
+	{
+		meshJob->m_chunk->UploadMesh();
+		m_numPendingMeshJobs--;
+		delete meshJob;
+	}
+}
+
+void World::QueueChunkReadAhead()
+{
+	Vec2 playerPosition2D = m_game->m_cameraPosition.GetXY();
+	IntVec2 playerChunkCoords = IntVec2(RoundDownToInt(playerPosition2D.x / (float)CHUNK_SIZE_X), RoundDownToInt(playerPosition2D.y / (float)CHUNK_SIZE_Y));
+	if (m_regionReadAheadChunks <= 0 || (m_hasReadAheadChunkCoords && playerChunkCoords == m_readAheadChunkCoords))
+	{
+		return;
+	}
+
+	// The direction of travel is taken from the last chunk border the player crossed
+	bool hasTravelDirection = m_hasReadAheadChunkCoords;
+	Vec2 travelDirection = hasTravelDirection ? (playerChunkCoords - m_readAheadChunkCoords).GetAsVec2().GetNormalized() : Vec2::ZERO;
+	m_readAheadChunkCoords = playerChunkCoords;
+	m_hasReadAheadChunkCoords = true;
+	if (!hasTravelDirection)
+	{
+		return;
+	}
+
+	// Only saved chunks in a band just past the activation radius, within 60 degrees of the direction of travel, are read ahead
+	float readAheadStartDistance = g_activationRadius;
+	float readAheadEndDistance = g_activationRadius + (float)(m_regionReadAheadChunks * CHUNK_SIZE_X);
+	int chunkRange = (int)ceilf(readAheadEndDistance / (float)CHUNK_SIZE_X);
+	std::vector<IntVec2> readAheadChunkCoords;
+	for (int y = -chunkRange; y <= chunkRange; y++)
+	{
+		for (int x = -chunkRange; x <= chunkRange; x++)
+		{
+			IntVec2 chunkCoords = playerChunkCoords + IntVec2(x, y);
+			Vec2 chunkCenterXY = chunkCoords.GetAsVec2() * Vec2(CHUNK_SIZE_X, CHUNK_SIZE_Y) + Vec2(CHUNK_SIZE_X * 0.5f, CHUNK_SIZE_Y * 0.5f);
+			Vec2 displacementToChunk = chunkCenterXY - playerPosition2D;
+			float distanceToChunk = displacementToChunk.GetLength();
+			if (distanceToChunk <= readAheadStartDistance || distanceToChunk > readAheadEndDistance || DotProduct2D(displacementToChunk, travelDirection) < distanceToChunk * 0.5f)
+			{
+				continue;
+			}
+
+			if (GetChunkState(chunkCoords) == ChunkState::ON_DISK)
+			{
+				readAheadChunkCoords.push_back(chunkCoords);
+			}
+		}
+	}
+
+	if (!readAheadChunkCoords.empty())
+	{
+		g_jobSystem->QueueJob(new ChunkReadAheadJob(this, readAheadChunkCoords));
+	}
 }
 
 bool World::RequestActivationOfNearestChunkInRange(float range)
@@ -400,6 +620,12 @@ void World::ActivateChunk(Chunk* chunk)
 		chunk->m_southNeighbor->m_northNeighbor = chunk;
 	}
 
+	// Reconciling and dirtying border lighting reads the neighbors' blocks
+	chunk->ExpandBlocksWithNeighbors();
+	if (chunk->m_hasSavedLighting)
+	{
+		chunk->ReconcileSavedBorderLighting();
+	}
 	DirtyChunkLighting(chunk);
 	m_activeChunks[chunkCoords] = chunk;
 	chunk->m_state = ChunkState::ACTIVE;
@@ -412,145 +638,71 @@ void World::DirtyChunkLighting(Chunk* chunk)
 {
 	//--------------------------------------------------------------------------------
 	// Lighting for chunk
-
-	// Mark all WEST face blocks as having dirty lighting
-	// Allows propagation of light from other chunks into this chunk and vice-versa
-	for (int y = 0; y < CHUNK_SIZE_Y; y++)
+	// Sky flags and light within the chunk were already solved by the worker that generated or loaded it
+	// Only blocks that can pass light across a border with an active neighbor need to be marked dirty
+	if (chunk->m_eastNeighbor)
 	{
-		for (int z = 0; z < CHUNK_SIZE_Z; z++)
+		for (int y = 0; y < CHUNK_SIZE_Y; y++)
 		{
-			IntVec3 blockCoords = IntVec3(0, y, z);
-			int blockIndex = chunk->GetBlockIndexFromCoords(blockCoords);
-
-			if (chunk->m_blocks[blockIndex].IsOpaque())
+			for (int z = 0; z < CHUNK_SIZE_Z; z++)
 			{
-				continue;
+				BlockIter blockIter = BlockIter(chunk, chunk->GetBlockIndexFromCoords(CHUNK_SIZE_X - 1, y, z));
+				BlockIter neighborBlockIter = BlockIter(chunk->m_eastNeighbor, chunk->GetBlockIndexFromCoords(0, y, z));
+				DirtyLightingAcrossBorder(blockIter, neighborBlockIter);
 			}
-
-			BlockIter blockIter = BlockIter(chunk, blockIndex);;
-			MarkBlockLightingDirty(blockIter);
 		}
 	}
-	// Mark all EAST face blocks as having dirty lighting
-	for (int y = 0; y < CHUNK_SIZE_Y; y++)
+	if (chunk->m_westNeighbor)
 	{
-		for (int z = 0; z < CHUNK_SIZE_Z; z++)
+		for (int y = 0; y < CHUNK_SIZE_Y; y++)
 		{
-			IntVec3 blockCoords = IntVec3(CHUNK_SIZE_X - 1, y, z);
-			int blockIndex = chunk->GetBlockIndexFromCoords(blockCoords);
-
-			if (chunk->m_blocks[blockIndex].IsOpaque())
+			for (int z = 0; z < CHUNK_SIZE_Z; z++)
 			{
-				continue;
+				BlockIter blockIter = BlockIter(chunk, chunk->GetBlockIndexFromCoords(0, y, z));
+				BlockIter neighborBlockIter = BlockIter(chunk->m_westNeighbor, chunk->GetBlockIndexFromCoords(CHUNK_SIZE_X - 1, y, z));
+				DirtyLightingAcrossBorder(blockIter, neighborBlockIter);
 			}
-
-			BlockIter blockIter = BlockIter(chunk, blockIndex);
-			MarkBlockLightingDirty(blockIter);
 		}
 	}
-	// Mark all SOUTH face blocks as having dirty lighting
-	for (int x = 0; x < CHUNK_SIZE_X; x++)
+	if (chunk->m_northNeighbor)
 	{
-		for (int z = 0; z < CHUNK_SIZE_Z; z++)
+		for (int x = 0; x < CHUNK_SIZE_X; x++)
 		{
-			IntVec3 blockCoords = IntVec3(x, 0, z);
-			int blockIndex = chunk->GetBlockIndexFromCoords(blockCoords);
-
-			if (chunk->m_blocks[blockIndex].IsOpaque())
+			for (int z = 0; z < CHUNK_SIZE_Z; z++)
 			{
-				continue;
+				BlockIter blockIter = BlockIter(chunk, chunk->GetBlockIndexFromCoords(x, CHUNK_SIZE_Y - 1, z));
+				BlockIter neighborBlockIter = BlockIter(chunk->m_northNeighbor, chunk->GetBlockIndexFromCoords(x, 0, z));
+				DirtyLightingAcrossBorder(blockIter, neighborBlockIter);
 			}
-
-			BlockIter blockIter = BlockIter(chunk, blockIndex);
-			MarkBlockLightingDirty(blockIter);
 		}
 	}
-	// Mark all NORTH face blocks as having dirty lighting
-	for (int x = 0; x < CHUNK_SIZE_X; x++)
+	if (chunk->m_southNeighbor)
 	{
-		for (int z = 0; z < CHUNK_SIZE_Z; z++)
+		for (int x = 0; x < CHUNK_SIZE_X; x++)
 		{
-			IntVec3 blockCoords = IntVec3(x, CHUNK_SIZE_Y - 1, z);
-			int blockIndex = chunk->GetBlockIndexFromCoords(blockCoords);
-
-			if (chunk->m_blocks[blockIndex].IsOpaque())
+			for (int z = 0; z < CHUNK_SIZE_Z; z++)
 			{
-				continue;
+				BlockIter blockIter = BlockIter(chunk, chunk->GetBlockIndexFromCoords(x, 0, z));
+				BlockIter neighborBlockIter = BlockIter(chunk->m_southNeighbor, chunk->GetBlockIndexFromCoords(x, CHUNK_SIZE_Y - 1, z));
+				DirtyLightingAcrossBorder(blockIter, neighborBlockIter);
 			}
-
-			BlockIter blockIter = BlockIter(chunk, blockIndex);
-			MarkBlockLightingDirty(blockIter);
-		}
-	}
-
-	for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
-	{
-		if (chunk->m_blocks[blockIndex].GetDefinition().m_lightInfluence != 0)
-		{
-			BlockIter blockIter = BlockIter(chunk, blockIndex);
-			MarkBlockLightingDirty(blockIter);
 		}
 	}
+}
 
-	for (int x = 0; x < CHUNK_SIZE_X; x++)
+void World::DirtyLightingAcrossBorder(BlockIter const& blockIterA, BlockIter const& blockIterB)
+{
+	// A block only needs to spread its light again if it can raise either light value of its neighbor across the border
+	bool canALightB = (blockIterA.GetIndoorLightInfluence() - 1 > blockIterB.GetIndoorLightInfluence()) || (blockIterA.GetOutdoorLightInfluence() - 1 > blockIterB.GetOutdoorLightInfluence());
+	if (canALightB && !blockIterB.IsOpaque())
 	{
-		for (int y = 0; y < CHUNK_SIZE_Y; y++)
-		{
-			IntVec3 skywardBlockCoords = IntVec3(x, y, CHUNK_SIZE_Z - 1);
-			int blockIndex = chunk->GetBlockIndexFromCoords(skywardBlockCoords);
-			BlockIter currentBlockIter = BlockIter(chunk, blockIndex);
-			Block* block = currentBlockIter.GetBlock();
-			while (block && !block->IsOpaque())
-			{
-				block->SetSky(true);
-
-				currentBlockIter = currentBlockIter.GetGroundwardBlock();
-				block = currentBlockIter.GetBlock();
-			}
-		}
+		MarkBlockLightingDirty(blockIterA);
 	}
 
-	for (int x = 0; x < CHUNK_SIZE_X; x++)
+	bool canBLightA = (blockIterB.GetIndoorLightInfluence() - 1 > blockIterA.GetIndoorLightInfluence()) || (blockIterB.GetOutdoorLightInfluence() - 1 > blockIterA.GetOutdoorLightInfluence());
+	if (canBLightA && !blockIterA.IsOpaque())
 	{
-		for (int y = 0; y < CHUNK_SIZE_Y; y++)
-		{
-			IntVec3 skywardBlockCoords = IntVec3(x, y, CHUNK_SIZE_Z - 1);
-			int blockIndex = chunk->GetBlockIndexFromCoords(skywardBlockCoords);
-			BlockIter currentBlockIter = BlockIter(chunk, blockIndex);
-			Block* block = currentBlockIter.GetBlock();
-			while (block && !block->IsOpaque())
-			{
-				BlockIter eastBlockIter = currentBlockIter.GetEastBlock();
-				BlockIter westBlockIter = currentBlockIter.GetWestBlock();
-				BlockIter northBlockIter = currentBlockIter.GetNorthBlock();
-				BlockIter southBlockIter = currentBlockIter.GetSouthBlock();
-
-				Block* eastBlock = eastBlockIter.GetBlock();
-				Block* westBlock = westBlockIter.GetBlock();
-				Block* northBlock = northBlockIter.GetBlock();
-				Block* southBlock = southBlockIter.GetBlock();
-
-				if (eastBlock && !eastBlock->IsOpaque() && !eastBlock->IsSky() && !eastBlock->IsLightDirty())
-				{
-					MarkBlockLightingDirty(eastBlockIter);
-				}
-				if (westBlock && !westBlock->IsOpaque() && !westBlock->IsSky() && !westBlock->IsLightDirty())
-				{
-					MarkBlockLightingDirty(westBlockIter);
-				}
-				if (northBlock && !northBlock->IsOpaque() && !northBlock->IsSky() && !northBlock->IsLightDirty())
-				{
-					MarkBlockLightingDirty(northBlockIter);
-				}
-				if (southBlock && !southBlock->IsOpaque() && !southBlock->IsSky() && !southBlock->IsLightDirty())
-				{
-					MarkBlockLightingDirty(southBlockIter);
-				}
-
-				currentBlockIter = currentBlockIter.GetGroundwardBlock();
-				block = currentBlockIter.GetBlock();
-			}
-		}
+		MarkBlockLightingDirty(blockIterB);
 	}
 }
 
@@ -643,14 +795,23 @@ SimpleMinerRaycastResult World::RaycastVsBlocks(Vec3 const& startPosition, Vec3
 
 	while (totalRayLength < maxDistance)
 	{
-		Block* currentBlock = currentBlockIter.GetBlock();
-	
-		if (!currentBlock)
+		if (!currentBlockIter.IsValid())
 		{
 			return raycastResult;
 		}
 
-		if (currentBlock->IsSolid())
+		// Nothing above the surface of a column can be hit, so the block itself does not need to be read
+		int currentColumnIndex = currentBlockIter.m_blockIndex & (CHUNK_BLOCKS_PER_LAYER - 1);
+		int currentZ = currentBlockIter.m_blockIndex >> (CHUNK_XBITS + CHUNK_YBITS);
+		bool isBelowSurface = currentZ < currentBlockIter.m_chunk->GetSurfaceHeight(currentColumnIndex);
+		bool isSolid = false;
+		if (isBelowSurface && !currentBlockIter.m_chunk->IsBlockSolidInUniformSection(currentBlockIter.m_blockIndex, isSolid))
+		{
+			// Only mixed sections need the blocks themselves, which may have to be expanded first
+			currentBlockIter.m_chunk->ExpandBlocks();
+			isSolid = currentBlockIter.IsSolid();
+		}
+		if (isSolid)
 		{
 			Vec3 impactPosition = startPosition + direction * (totalRayLength - deltaRayLength);
 			raycastResult.m_didImpact = true;
@@ -662,21 +823,21 @@ SimpleMinerRaycastResult World::RaycastVsBlocks(Vec3 const& startPosition, Vec3
 
 		if (cumulativeRayLengthIn1D.x < cumulativeRayLengthIn1D.y && cumulativeRayLengthIn1D.x < cumulativeRayLengthIn1D.z)
 		{
-			currentBlockIter = directionXYZ.x == 1 ? currentBlockIter.GetEastBlock() : currentBlockIter.GetWestBlock();
+			currentBlockIter = directionXYZ.x == 1 ? currentBlockIter.Step<Direction::EAST>() : currentBlockIter.Step<Direction::WEST>();
 			totalRayLength = cumulativeRayLengthIn1D.x;
 			cumulativeRayLengthIn1D.x += rayStepSize.x;
 			raycastResult.m_impactNormal = -Vec3::EAST * (float)directionXYZ.x;
 		}
 		else if (cumulativeRayLengthIn1D.y < cumulativeRayLengthIn1D.z)
 		{
-			currentBlockIter = directionXYZ.y == 1 ? currentBlockIter.GetNorthBlock() : currentBlockIter.GetSouthBlock();
+			currentBlockIter = directionXYZ.y == 1 ? currentBlockIter.Step<Direction::NORTH>() : currentBlockIter.Step<Direction::SOUTH>();
 			totalRayLength = cumulativeRayLengthIn1D.y;
 			cumulativeRayLengthIn1D.y += rayStepSize.y;
 			raycastResult.m_impactNormal = -Vec3::NORTH * (float)directionXYZ.y;
 		}
 		else
 		{
-			currentBlockIter = directionXYZ.z == 1 ? currentBlockIter.GetSkywardBlock() : currentBlockIter.GetGroundwardBlock();
+			currentBlockIter = directionXYZ.z == 1 ? currentBlockIter.Step<Direction::SKYWARD>() : currentBlockIter.Step<Direction::GROUNDWARD>();
 			totalRayLength = cumulativeRayLengthIn1D.z;
 			cumulativeRayLengthIn1D.z += rayStepSize.z;
 			raycastResult.m_impactNormal = -Vec3::SKYWARD * (float)directionXYZ.z;
@@ -692,153 +853,883 @@ SimpleMinerRaycastResult World::RaycastVsBlocks(Vec3 const& startPosition, Vec3
 
 std::string World::GetSaveFilePath() const
 {
-	CreateFolder(Stringf("Saves/World_%u/", m_worldSeed).c_str());
-
-	return Stringf("Saves/World_%u/", m_worldSeed);
+	return m_saveFilePath;
 }
 
-int World::GetChunkFileVersion() const
+ChunkState World::GetChunkState(IntVec2 const& chunkCoords) const
 {
-	return 2;
+	auto chunkMapIter = m_activeChunks.find(chunkCoords);
+	if (chunkMapIter != m_activeChunks.end())
+	{
+		return chunkMapIter->second->m_state;
+	}
+
+	return (m_chunkCoordsOnDisk.find(chunkCoords) != m_chunkCoordsOnDisk.end()) ? ChunkState::ON_DISK : ChunkState::MISSING;
 }
 
-void World::MarkBlockLightingDirty(BlockIter blockIter)
+void World::SaveSession() const
 {
-	if (m_disableLighting)
+	// Where the player was and which chunks were around them, so that the next session can resume there
+	std::vector<uint8_t> sessionContents;
+	sessionContents.reserve(SESSION_FILE_HEADER_SIZE + m_activeChunks.size() * 8);
+	sessionContents.push_back('G');
+	sessionContents.push_back('S');
+	sessionContents.push_back('E');
+	sessionContents.push_back('S');
+	sessionContents.push_back((uint8_t)SESSION_FILE_VERSION);
+	WriteSessionFloat(sessionContents, m_game->m_cameraPosition.x);
+	WriteSessionFloat(sessionContents, m_game->m_cameraPosition.y);
+	WriteSessionFloat(sessionContents, m_game->m_cameraPosition.z);
+	WriteSessionFloat(sessionContents, m_game->m_cameraOrientation.m_yawDegrees);
+	WriteSessionFloat(sessionContents, m_game->m_cameraOrientation.m_pitchDegrees);
+	WriteSessionFloat(sessionContents, m_game->m_cameraOrientation.m_rollDegrees);
+	WriteSessionFloat(sessionContents, m_worldTime);
+	WriteUint32(sessionContents, (uint32_t)m_activeChunks.size());
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
 	{
-		return;
+		WriteUint32(sessionContents, (uint32_t)chunkMapIter->first.x);
+		WriteUint32(sessionContents, (uint32_t)chunkMapIter->first.y);
 	}
 
-	blockIter.GetBlock()->SetLightDirty(true);
-	m_dirtyLightingQueue.push(blockIter);
+	FileWriteBuffer(m_saveFilePath + "Session.save", sessionContents);
 }
 
-extern double g_lightingProcessingTime;
-void World::ProcessDirtyLighting()
+bool World::RestoreSession()
 {
-	double lightingProcessingStartTime = GetCurrentTimeSeconds();
+	std::string sessionFilePath = m_saveFilePath + "Session.save";
+	std::vector<uint8_t> sessionContents;
+	if (FileReadToBuffer(sessionContents, sessionFilePath) <= 0)
+	{
+		return false;
+	}
 
-	while (!m_dirtyLightingQueue.empty())
+	if (sessionContents.size() < SESSION_FILE_HEADER_SIZE || sessionContents[0] != 'G' || sessionContents[1] != 'S' || sessionContents[2] != 'E' || sessionContents[3] != 'S' || sessionContents[4] != SESSION_FILE_VERSION)
 	{
-		ProcessNextDirtyLightBlock();
+		g_console->AddLine(Stringf("Invalid session file %s. The session will start from scratch!", sessionFilePath.c_str()));
+		return false;
 	}
 
-	double lightingProcessingEndTime = GetCurrentTimeSeconds();
-	g_lightingProcessingTime = (lightingProcessingEndTime - lightingProcessingStartTime) * 1000.f;
+	uint32_t numChunks = ReadUint32(&sessionContents[SESSION_FILE_HEADER_SIZE - 4]);
+	if (sessionContents.size() != SESSION_FILE_HEADER_SIZE + (size_t)numChunks * 8)
+	{
+		g_console->AddLine(Stringf("Session file %s lists %u chunks but has %d bytes. The session will start from scratch!", sessionFilePath.c_str(), numChunks, (int)sessionContents.size()));
+		return false;
+	}
+
+	m_game->m_cameraPosition = Vec3(ReadSessionFloat(&sessionContents[5]), ReadSessionFloat(&sessionContents[9]), ReadSessionFloat(&sessionContents[13]));
+	m_game->m_cameraOrientation = EulerAngles(ReadSessionFloat(&sessionContents[17]), ReadSessionFloat(&sessionContents[21]), ReadSessionFloat(&sessionContents[25]));
+	m_worldTime = ReadSessionFloat(&sessionContents[29]);
+
+	// The last session's chunks are activated first during pregeneration
+	m_pregenerationChunkCoords.clear();
+	for (uint32_t chunkIndex = 0; chunkIndex < numChunks && (int)chunkIndex < MAX_CHUNKS; chunkIndex++)
+	{
+		uint8_t const* sessionEntry = &sessionContents[SESSION_FILE_HEADER_SIZE + chunkIndex * 8];
+		m_pregenerationChunkCoords.push_back(IntVec2((int)ReadUint32(sessionEntry), (int)ReadUint32(sessionEntry + 4)));
+	}
+	return true;
 }
 
-void World::ProcessNextDirtyLightBlock()
+void World::BeginPregeneration()
 {
-	BlockIter blockIter = m_dirtyLightingQueue.front();
-	m_dirtyLightingQueue.pop();
+	Vec2 playerPosition2D = m_game->m_cameraPosition.GetXY();
+	IntVec2 playerChunkCoords = IntVec2(RoundDownToInt(playerPosition2D.x / (float)CHUNK_SIZE_X), RoundDownToInt(playerPosition2D.y / (float)CHUNK_SIZE_Y));
 
-	Block* block = blockIter.GetBlock();
-	block->SetLightDirty(false);
-	int currentIndoorLightInfluence = block->GetIndoorLightInfluence();
-	int currentOutdoorLightInfluence = block->GetOutdoorLightInfluence();
+	// Spawn chunks are added nearest first, so the chunk limit only ever cuts off the outermost ones
+	// A ring one chunk wider than the spawn radius is activated, so every chunk inside the radius has the neighbors it needs to be meshed
+	std::vector<std::pair<float, IntVec2>> spawnChunks;
+	float activationRadius = m_spawnPregenerationRadius + (float)CHUNK_SIZE_X;
+	int chunkRange = (int)ceilf(activationRadius / (float)CHUNK_SIZE_X);
+	for (int y = -chunkRange; y <= chunkRange; y++)
+	{
+		for (int x = -chunkRange; x <= chunkRange; x++)
+		{
+			IntVec2 chunkCoords = playerChunkCoords + IntVec2(x, y);
+			Vec2 chunkCenterXY = chunkCoords.GetAsVec2() * Vec2(CHUNK_SIZE_X, CHUNK_SIZE_Y) + Vec2(CHUNK_SIZE_X * 0.5f, CHUNK_SIZE_Y * 0.5f);
+			if (IsPointInsideDisc2D(chunkCenterXY, playerPosition2D, activationRadius))
+			{
+				spawnChunks.push_back(std::make_pair(GetDistanceSquared2D(chunkCenterXY, playerPosition2D), chunkCoords));
+			}
+		}
+	}
+	std::sort(spawnChunks.begin(), spawnChunks.end(), [](std::pair<float, IntVec2> const& spawnChunkA, std::pair<float, IntVec2> const& spawnChunkB) { return spawnChunkA.first < spawnChunkB.first; });
 
-	int minOutdoorLightInfluence = 0;
-	if (block->IsSky())
+	for (int spawnChunkIndex = 0; spawnChunkIndex < (int)spawnChunks.size() && (int)m_pregenerationChunkCoords.size() < MAX_CHUNKS; spawnChunkIndex++)
 	{
-		minOutdoorLightInfluence = OUTDOOR_LIGHTINFLUENCE_MAX;
+		if (std::find(m_pregenerationChunkCoords.begin(), m_pregenerationChunkCoords.end(), spawnChunks[spawnChunkIndex].second) == m_pregenerationChunkCoords.end())
+		{
+			m_pregenerationChunkCoords.push_back(spawnChunks[spawnChunkIndex].second);
+		}
 	}
-	int minLightInfluence = block->GetDefinition().m_lightInfluence;
-	
-	BlockIter eastBlockIter = blockIter.GetEastBlock();
-	BlockIter westBlockIter = blockIter.GetWestBlock();
-	BlockIter northBlockIter = blockIter.GetNorthBlock();
-	BlockIter southBlockIter = blockIter.GetSouthBlock();
-	BlockIter skywardBlockIter = blockIter.GetSkywardBlock();
-	BlockIter groundwardBlockIter = blockIter.GetGroundwardBlock();
 
-	Block* eastBlock = eastBlockIter.GetBlock();
-	Block* westBlock = westBlockIter.GetBlock();
-	Block* northBlock = northBlockIter.GetBlock();
-	Block* southBlock = southBlockIter.GetBlock();
-	Block* skywardBlock = skywardBlockIter.GetBlock();
-	Block* groundwardBlock = groundwardBlockIter.GetBlock();
+	// Every chunk is queued at once, so loading and generating them is spread over all the workers instead of one activation per frame
+	for (int chunkIndex = 0; chunkIndex < (int)m_pregenerationChunkCoords.size(); chunkIndex++)
+	{
+		IntVec2 const& chunkCoords = m_pregenerationChunkCoords[chunkIndex];
+		if (!GetChunkAtCoords(chunkCoords) && m_chunkCoordsQueuedForActivation.find(chunkCoords) == m_chunkCoordsQueuedForActivation.end())
+		{
+			RequestChunkActivation(chunkCoords);
+		}
+	}
 
-	// Get indoor light influences for each neighbor
-	int eastILI = eastBlock ? eastBlock->GetIndoorLightInfluence() : 0;
-	int westILI = westBlock ? westBlock->GetIndoorLightInfluence() : 0;
-	int northILI = northBlock ? northBlock->GetIndoorLightInfluence() : 0;
-	int southILI = southBlock ? southBlock->GetIndoorLightInfluence() : 0;
-	int skywardILI = skywardBlock ? skywardBlock->GetIndoorLightInfluence() : 0;
-	int groundwardILI = groundwardBlock ? groundwardBlock->GetIndoorLightInfluence() : 0;
+	m_hasQueuedPregenerationMeshes = false;
+	m_isPregenerationComplete = false;
+	m_numPregenerationMeshes = 0;
+	m_pregenerationProgress = 0.f;
+	m_pregenerationStatus = "Generating chunks";
+}
 
-	// Get outdoor light influences for each neighbor
-	int eastOLI = eastBlock ? eastBlock->GetOutdoorLightInfluence() : 0;
-	int westOLI = westBlock ? westBlock->GetOutdoorLightInfluence() : 0;
-	int northOLI = northBlock ? northBlock->GetOutdoorLightInfluence() : 0;
-	int southOLI = southBlock ? southBlock->GetOutdoorLightInfluence() : 0;
-	int skywardOLI = skywardBlock ? skywardBlock->GetOutdoorLightInfluence() : 0;
-	int groundwardOLI = groundwardBlock ? groundwardBlock->GetOutdoorLightInfluence() : 0;
+bool World::UpdatePregeneration()
+{
+	// Every completed job is handled as soon as it is done, rather than one per frame as during gameplay
+	while (!m_deferredCompletedJobs.empty())
+	{
+		Job* completedJob = m_deferredCompletedJobs.front();
+		m_deferredCompletedJobs.erase(m_deferredCompletedJobs.begin());
+		HandleCompletedJob(completedJob);
+	}
+	for (Job* completedJob = g_jobSystem->GetCompletedJob(); completedJob; completedJob = g_jobSystem->GetCompletedJob())
+	{
+		HandleCompletedJob(completedJob);
+	}
 
-	int indoorLightInfluences[] = {eastILI, westILI, northILI, southILI, skywardILI, groundwardILI};
-	int neighborMaxIndoorLightInfluence = GetMax(6, indoorLightInfluences);
-	int outdoorLightInfluences[] = {eastOLI, westOLI, northOLI, southOLI, skywardOLI, groundwardOLI};
-	int neighborMaxOutdoorLightInfluence = GetMax(6, outdoorLightInfluences);
-	
-	int indoorLightInfluence = GetMax(minLightInfluence, neighborMaxIndoorLightInfluence - 1);
-	int outdoorLightInfluence = GetMax(minOutdoorLightInfluence, neighborMaxOutdoorLightInfluence - 1);
+	int numPregenerationChunks = GetMax((int)m_pregenerationChunkCoords.size(), 1);
+	if (!m_chunkCoordsQueuedForActivation.empty())
+	{
+		int numActivatedChunks = numPregenerationChunks - (int)m_chunkCoordsQueuedForActivation.size();
+		m_pregenerationProgress = PREGENERATION_ACTIVATION_PROGRESS * (float)numActivatedChunks / (float)numPregenerationChunks;
+		m_pregenerationStatus = Stringf("Generating chunks: %d / %d", numActivatedChunks, numPregenerationChunks);
+		return false;
+	}
 
-	if (block->IsOpaque())
+	if (!m_hasQueuedPregenerationMeshes)
 	{
-		indoorLightInfluence = minLightInfluence;
-		outdoorLightInfluence = minOutdoorLightInfluence;
+		// Lighting phases already solve non-adjacent chunks on all the workers; one round per frame keeps the progress indicator drawing
+		if (!m_disableLighting)
+		{
+			bool didProcessLighting = ProcessLightingPhase(0);
+			didProcessLighting = ProcessLightingPhase(1) || didProcessLighting;
+			if (didProcessLighting)
+			{
+				int numLitChunks = (int)m_activeChunks.size() - (int)m_lightingWorklist.size();
+				m_pregenerationProgress = PREGENERATION_ACTIVATION_PROGRESS + PREGENERATION_LIGHTING_PROGRESS * (float)GetMax(numLitChunks, 0) / (float)GetMax((int)m_activeChunks.size(), 1);
+				m_pregenerationStatus = Stringf("Lighting chunks: %d / %d", GetMax(numLitChunks, 0), (int)m_activeChunks.size());
+				return false;
+			}
+		}
+
+		QueuePregenerationMeshes();
+		m_hasQueuedPregenerationMeshes = true;
 	}
 
-	if ((indoorLightInfluence != currentIndoorLightInfluence) || (outdoorLightInfluence != currentOutdoorLightInfluence))
+	// Meshes are uploaded by HandleCompletedJob as their jobs finish, so the loading screen keeps drawing in between
+	if (m_numPendingMeshJobs > 0)
 	{
-		block->SetIndoorLightInfluence(indoorLightInfluence);
-		block->SetOutdoorLightInfluence(outdoorLightInfluence);
+		int numBuiltMeshes = m_numPregenerationMeshes - m_numPendingMeshJobs;
+		m_pregenerationProgress = PREGENERATION_ACTIVATION_PROGRESS + PREGENERATION_LIGHTING_PROGRESS + (1.f - PREGENERATION_ACTIVATION_PROGRESS - PREGENERATION_LIGHTING_PROGRESS) * (float)numBuiltMeshes / (float)GetMax(m_numPregenerationMeshes, 1);
+		m_pregenerationStatus = Stringf("Building meshes: %d / %d", numBuiltMeshes, m_numPregenerationMeshes);
+		return false;
+	}
 
-		blockIter.m_chunk->m_isCpuMeshDirty = true;
-		if (blockIter.m_chunk->m_eastNeighbor)
+	m_pregenerationChunkCoords.clear();
+	m_pregenerationProgress = 1.f;
+	m_isPregenerationComplete = true;
+	return true;
+}
+
+void World::QueuePregenerationMeshes()
+{
+	// Mesh jobs only read blocks, so every chunk (and the neighbors it reads) is expanded on the main thread before they start
+	std::vector<Chunk*> meshChunks;
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
+	{
+		Chunk* chunk = chunkMapIter->second;
+		if (chunk->m_dirtyMeshSections == 0 || !chunk->m_eastNeighbor || !chunk->m_westNeighbor || !chunk->m_northNeighbor || !chunk->m_southNeighbor || chunk->HasDirtyLighting())
 		{
-			blockIter.m_chunk->m_eastNeighbor->m_isCpuMeshDirty = true;
+			continue;
 		}
-		if (blockIter.m_chunk->m_westNeighbor)
+
+		chunk->ExpandBlocksWithNeighbors();
+		meshChunks.push_back(chunk);
+	}
+
+	for (int chunkIndex = 0; chunkIndex < (int)meshChunks.size(); chunkIndex++)
+	{
+		g_jobSystem->QueueJob(new ChunkMeshJob(meshChunks[chunkIndex]));
+	}
+	m_numPendingMeshJobs += (int)meshChunks.size();
+	m_numPregenerationMeshes = (int)meshChunks.size();
+}
+
+void World::WaitForChunkJobs()
+{
+	// Activation and mesh jobs write to chunks (and read their neighbors) that only the world owns, so it cannot let go of them while any is running
+	// Chunks that were still activating are dropped; nothing has edited them, so there is nothing to save
+	std::vector<Job*> otherCompletedJobs;
+	while (m_numPendingMeshJobs > 0 || !m_chunkCoordsQueuedForActivation.empty())
+	{
+		Job* completedJob = nullptr;
+		if (!m_deferredCompletedJobs.empty())
 		{
-			blockIter.m_chunk->m_westNeighbor->m_isCpuMeshDirty = true;
+			completedJob = m_deferredCompletedJobs.front();
+			m_deferredCompletedJobs.erase(m_deferredCompletedJobs.begin());
 		}
-		if (blockIter.m_chunk->m_northNeighbor)
+		else
 		{
-			blockIter.m_chunk->m_northNeighbor->m_isCpuMeshDirty = true;
+			completedJob = g_jobSystem->GetCompletedJob();
 		}
-		if (blockIter.m_chunk->m_southNeighbor)
+		if (!completedJob)
 		{
-			blockIter.m_chunk->m_southNeighbor->m_isCpuMeshDirty = true;
+			std::this_thread::yield();
+			continue;
 		}
 
-		if (eastBlock && !eastBlock->IsOpaque() && !eastBlock->IsLightDirty())
+		ChunkGenerateJob* generateJob = dynamic_cast<ChunkGenerateJob*>(completedJob);
+		ChunkLoadJob* loadJob = dynamic_cast<ChunkLoadJob*>(completedJob);
+		Chunk* activatingChunk = generateJob ? generateJob->m_chunk : (loadJob ? loadJob->m_chunk : nullptr);
+		if (activatingChunk)
 		{
-			MarkBlockLightingDirty(eastBlockIter);
+			m_chunkCoordsQueuedForActivation.erase(activatingChunk->m_coords);
+			delete activatingChunk;
+			delete completedJob;
+			continue;
 		}
 
-		if (westBlock && !westBlock->IsOpaque() && !westBlock->IsLightDirty())
+		if (dynamic_cast<ChunkMeshJob*>(completedJob))
 		{
-			MarkBlockLightingDirty(westBlockIter);
+			m_numPendingMeshJobs--;
+			delete completedJob;
+			continue;
 		}
 
-		if (northBlock && !northBlock->IsOpaque() && !northBlock->IsLightDirty())
-		{
-			MarkBlockLightingDirty(northBlockIter);
-		}
+		otherCompletedJobs.push_back(completedJob);
+	}
 
-		if (southBlock && !southBlock->IsOpaque() && !southBlock->IsLightDirty())
-		{
-			MarkBlockLightingDirty(southBlockIter);
-		}
+	m_deferredCompletedJobs.insert(m_deferredCompletedJobs.end(), otherCompletedJobs.begin(), otherCompletedJobs.end());
+}
 
-		if (skywardBlock && !skywardBlock->IsOpaque() && !skywardBlock->IsLightDirty())
-		{
-			MarkBlockLightingDirty(skywardBlockIter);
-		}
+bool World::LoadChunkManifest()
+{
+	std::string manifestFilePath = m_saveFilePath + "Chunks.manifest";
+	std::vector<uint8_t> manifestContents;
+	if (FileReadToBuffer(manifestContents, manifestFilePath) <= 0)
+	{
+		return false;
+	}
 
-		if (groundwardBlock && !groundwardBlock->IsOpaque() && !groundwardBlock->IsLightDirty())
-		{
-			MarkBlockLightingDirty(groundwardBlockIter);
-		}
+	// The manifest is only rewritten at a clean shutdown, so it is removed once read; after a crash the index is rebuilt instead
+	std::remove(manifestFilePath.c_str());
+
+	if (manifestContents.size() < 9 || manifestContents[0] != 'G' || manifestContents[1] != 'M' || manifestContents[2] != 'A' || manifestContents[3] != 'N' || manifestContents[4] != CHUNK_MANIFEST_VERSION)
+	{
+		g_console->AddLine(Stringf("Invalid chunk manifest %s. The index will be rebuilt!", manifestFilePath.c_str()));
+		return false;
+	}
+
+	uint32_t numChunks = ReadUint32(&manifestContents[5]);
+	if (manifestContents.size() != 9 + (size_t)numChunks * 8)
+	{
+		g_console->AddLine(Stringf("Chunk manifest %s lists %u chunks but has %d bytes. The index will be rebuilt!", manifestFilePath.c_str(), numChunks, (int)manifestContents.size()));
+		return false;
 	}
+
+	m_chunkCoordsOnDisk.clear();
+	for (uint32_t chunkIndex = 0; chunkIndex < numChunks; chunkIndex++)
+	{
+		uint8_t const* manifestEntry = &manifestContents[9 + chunkIndex * 8];
+		m_chunkCoordsOnDisk.insert(IntVec2((int)ReadUint32(manifestEntry), (int)ReadUint32(manifestEntry + 4)));
+	}
+	return true;
+}
+
+void World::RebuildChunkManifest()
+{
+	m_chunkCoordsOnDisk.clear();
+
+	std::error_code errorCode;
+	for (std::filesystem::directory_iterator fileIter(m_saveFilePath, errorCode), endIter; !errorCode && fileIter != endIter; fileIter.increment(errorCode))
+	{
+		std::string fileName = fileIter->path().filename().string();
+
+		IntVec2 coords;
+		if (ParseCoordsFromFileName(fileName, "Region(", ").region", coords))
+		{
+			std::vector<IntVec2> storedChunkCoords;
+			RegionFile::ReadStoredChunkCoords(fileIter->path().string(), coords, storedChunkCoords);
+			m_chunkCoordsOnDisk.insert(storedChunkCoords.begin(), storedChunkCoords.end());
+		}
+		else if (ParseCoordsFromFileName(fileName, "Chunk(", ").chunk", coords))
+		{
+			m_chunkCoordsOnDisk.insert(coords);
+		}
+	}
+}
+
+void World::SaveChunkManifest() const
+{
+	std::vector<uint8_t> manifestContents;
+	manifestContents.reserve(9 + m_chunkCoordsOnDisk.size() * 8);
+	manifestContents.push_back('G');
+	manifestContents.push_back('M');
+	manifestContents.push_back('A');
+	manifestContents.push_back('N');
+	manifestContents.push_back((uint8_t)CHUNK_MANIFEST_VERSION);
+	WriteUint32(manifestContents, (uint32_t)m_chunkCoordsOnDisk.size());
+	for (auto coordsIter = m_chunkCoordsOnDisk.begin(); coordsIter != m_chunkCoordsOnDisk.end(); ++coordsIter)
+	{
+		WriteUint32(manifestContents, (uint32_t)coordsIter->x);
+		WriteUint32(manifestContents, (uint32_t)coordsIter->y);
+	}
+
+	FileWriteBuffer(m_saveFilePath + "Chunks.manifest", manifestContents);
+}
+
+RegionFile* World::GetRegionFileForChunk(IntVec2 const& chunkCoords)
+{
+	std::lock_guard<std::mutex> regionFilesLock(m_regionFilesMutex);
+
+	IntVec2 regionCoords = RegionFile::GetRegionCoordsForChunk(chunkCoords);
+	auto regionFileMapIter = m_regionFiles.find(regionCoords);
+	if (regionFileMapIter != m_regionFiles.end())
+	{
+		return regionFileMapIter->second;
+	}
+
+	RegionFile* regionFile = new RegionFile(GetSaveFilePath() + Stringf("Region(%d,%d).region", regionCoords.x, regionCoords.y));
+	m_regionFiles[regionCoords] = regionFile;
+	return regionFile;
+}
+
+std::shared_ptr<ChunkSaveSnapshot const> World::FindChunkSaveSnapshot(IntVec2 const& chunkCoords)
+{
+	// The pending snapshot is newer than the one being written, if both exist
+	std::lock_guard<std::mutex> chunkSavesLock(m_chunkSavesMutex);
+	auto pendingSaveMapIter = m_pendingChunkSaves.find(chunkCoords);
+	if (pendingSaveMapIter != m_pendingChunkSaves.end())
+	{
+		return pendingSaveMapIter->second;
+	}
+
+	auto inFlightSaveMapIter = m_inFlightChunkSaves.find(chunkCoords);
+	if (inFlightSaveMapIter != m_inFlightChunkSaves.end())
+	{
+		return inFlightSaveMapIter->second;
+	}
+	return nullptr;
+}
+
+bool World::ReadChunkData(IntVec2 const& chunkCoords, std::vector<uint8_t>& out_chunkData)
+{
+	RegionFile* regionFile = GetRegionFileForChunk(chunkCoords);
+	if (regionFile->ReadChunk(chunkCoords, out_chunkData))
+	{
+		return true;
+	}
+
+	// Chunks saved before region files existed are moved into their region the first time they are loaded
+	std::string legacyChunkFilePath = GetSaveFilePath() + Stringf("Chunk(%d,%d).chunk", chunkCoords.x, chunkCoords.y);
+	int numBytesRead = FileReadToBuffer(out_chunkData, legacyChunkFilePath);
+	if (numBytesRead <= 0)
+	{
+		out_chunkData.clear();
+		return false;
+	}
+
+	if (regionFile->WriteChunk(chunkCoords, out_chunkData))
+	{
+		std::remove(legacyChunkFilePath.c_str());
+	}
+	return true;
+}
+
+bool World::WriteChunkData(IntVec2 const& chunkCoords, std::vector<uint8_t> const& chunkData)
+{
+	return GetRegionFileForChunk(chunkCoords)->WriteChunk(chunkCoords, chunkData);
+}
+
+void World::QueueChunkSave(Chunk* chunk)
+{
+	if (!chunk->m_needsSaving)
+	{
+		return;
+	}
+
+	chunk->m_state = ChunkState::DEACTIVATING_SAVING;
+	std::shared_ptr<ChunkSaveSnapshot const> saveSnapshot(chunk->TakeSaveSnapshot());
+	m_chunkCoordsOnDisk.insert(chunk->m_coords);
+
+	bool isSaveJobQueued = false;
+	{
+		std::lock_guard<std::mutex> chunkSavesLock(m_chunkSavesMutex);
+		isSaveJobQueued = m_pendingChunkSaves.find(chunk->m_coords) != m_pendingChunkSaves.end() || m_inFlightChunkSaves.find(chunk->m_coords) != m_inFlightChunkSaves.end();
+		m_pendingChunkSaves[chunk->m_coords] = saveSnapshot;
+	}
+
+	// The job already queued (or running) for this chunk picks up the newer snapshot
+	if (!isSaveJobQueued)
+	{
+		g_jobSystem->QueueJob(new ChunkSaveJob(this, chunk->m_coords));
+	}
+}
+
+void World::SavePendingChunk(IntVec2 const& chunkCoords)
+{
+	std::unique_lock<std::mutex> chunkSavesLock(m_chunkSavesMutex);
+	while (true)
+	{
+		auto pendingSaveMapIter = m_pendingChunkSaves.find(chunkCoords);
+		if (pendingSaveMapIter == m_pendingChunkSaves.end())
+		{
+			m_inFlightChunkSaves.erase(chunkCoords);
+			return;
+		}
+
+		std::shared_ptr<ChunkSaveSnapshot const> saveSnapshot = pendingSaveMapIter->second;
+		m_inFlightChunkSaves[chunkCoords] = saveSnapshot;
+		m_pendingChunkSaves.erase(pendingSaveMapIter);
+		chunkSavesLock.unlock();
+
+		std::vector<uint8_t> chunkData;
+		Chunk::WriteChunkFileBuffer(*saveSnapshot, this, chunkData);
+		WriteChunkData(chunkCoords, chunkData);
+
+		chunkSavesLock.lock();
+	}
+}
+
+void World::FlushChunkSaves()
+{
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> chunkSavesLock(m_chunkSavesMutex);
+			if (m_pendingChunkSaves.empty() && m_inFlightChunkSaves.empty())
+			{
+				return;
+			}
+		}
+
+		Job* completedJob = g_jobSystem->GetCompletedJob();
+		if (!completedJob)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		ChunkSaveJob* saveJob = dynamic_cast<ChunkSaveJob*>(completedJob);
+		if (saveJob)
+		{
+			delete saveJob;
+			continue;
+		}
+
+		m_deferredCompletedJobs.push_back(completedJob);
+	}
+}
+
+int World::GetChunkFileVersion() const
+{
+	if (m_savePackedChunkFiles)
+	{
+		return CHUNK_FILE_VERSION_PACKED;
+	}
+
+	return m_saveChunkLighting ? CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING : CHUNK_FILE_VERSION_BLOCKS;
+}
+
+void World::MarkBlockLightingDirty(BlockIter blockIter)
+{
+	if (m_disableLighting)
+	{
+		return;
+	}
+
+	blockIter.m_chunk->MarkBlockLightingDirty(blockIter.m_blockIndex);
+	AddChunkToLightingWorklist(blockIter.m_chunk);
+}
+
+void World::RelightBlock(BlockIter blockIter)
+{
+	if (m_disableLighting)
+	{
+		return;
+	}
+
+	blockIter.m_chunk->RelightBlock(blockIter.m_blockIndex);
+	if (blockIter.m_chunk->HasDirtyLighting())
+	{
+		AddChunkToLightingWorklist(blockIter.m_chunk);
+	}
+}
+
+void World::RunLightingStressTest(int numEdits)
+{
+	if (m_disableLighting || m_activeChunks.empty())
+	{
+		g_console->AddLine("Cannot run lighting stress test: lighting is disabled or no chunks are active");
+		return;
+	}
+
+	// The edits are all undone again, so whether a chunk needs saving (and how edited it is) is restored afterwards
+	std::vector<Chunk*> chunks;
+	std::vector<bool> chunksNeedSaving;
+	std::vector<int> chunkNumEditedBlocks;
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
+	{
+		chunks.push_back(chunkMapIter->second);
+		chunksNeedSaving.push_back(chunkMapIter->second->m_needsSaving);
+		chunkNumEditedBlocks.push_back(chunkMapIter->second->m_numEditedBlocks);
+	}
+
+	// Settle any outstanding lighting first so that only the edits made here are measured
+	SolveAllDirtyLighting();
+
+	BlockDefinitionID editBlockIDs[] = { BlockDefinition::GetBlockIDByName("glowstone"), BlockDefinition::GetBlockIDByName("stone"), BlockDefinition::GetBlockIDByName("air") };
+
+	struct BlockEdit
+	{
+		Chunk* m_chunk = nullptr;
+		int m_blockIndex = -1;
+		BlockDefinitionID m_previousType = BLOCKTYPE_INVALID;
+	};
+	std::vector<BlockEdit> edits;
+
+	double editStartTime = GetCurrentTimeSeconds();
+	for (int editIndex = 0; editIndex < numEdits; editIndex++)
+	{
+		BlockEdit edit;
+		edit.m_chunk = chunks[g_RNG->RollRandomIntLessThan((int)chunks.size())];
+		IntVec3 blockCoords = IntVec3(g_RNG->RollRandomIntLessThan(CHUNK_SIZE_X), g_RNG->RollRandomIntLessThan(CHUNK_SIZE_Y), g_RNG->RollRandomIntLessThan(CHUNK_SIZE_Z));
+		edit.m_blockIndex = edit.m_chunk->GetBlockIndexFromCoords(blockCoords);
+		edit.m_chunk->ExpandBlocks();
+		edit.m_previousType = edit.m_chunk->GetBlockType(edit.m_blockIndex);
+		edits.push_back(edit);
+
+		edit.m_chunk->SetBlockType(edit.m_blockIndex, editBlockIDs[g_RNG->RollRandomIntLessThan(3)]);
+	}
+	SolveAllDirtyLighting();
+	double editEndTime = GetCurrentTimeSeconds();
+	int numIncorrectBlocksAfterEdits = GetNumBlocksWithIncorrectLighting();
+
+	// Undoing the edits in reverse order exercises light removal as much as the edits exercised light addition
+	for (int editIndex = (int)edits.size() - 1; editIndex >= 0; editIndex--)
+	{
+		BlockEdit const& edit = edits[editIndex];
+		edit.m_chunk->SetBlockType(edit.m_blockIndex, edit.m_previousType);
+	}
+	SolveAllDirtyLighting();
+	double undoEndTime = GetCurrentTimeSeconds();
+	int numIncorrectBlocksAfterUndo = GetNumBlocksWithIncorrectLighting();
+
+	for (int chunkIndex = 0; chunkIndex < (int)chunks.size(); chunkIndex++)
+	{
+		chunks[chunkIndex]->m_needsSaving = chunksNeedSaving[chunkIndex];
+		chunks[chunkIndex]->m_numEditedBlocks = chunkNumEditedBlocks[chunkIndex];
+	}
+
+	g_console->AddLine(Stringf("Lighting stress test: %d edits relit in %.2f ms, %d blocks incorrect", numEdits, (editEndTime - editStartTime) * 1000.f, numIncorrectBlocksAfterEdits));
+	g_console->AddLine(Stringf("Lighting stress test: %d edits undone and relit in %.2f ms, %d blocks incorrect", numEdits, (undoEndTime - editEndTime) * 1000.f, numIncorrectBlocksAfterUndo));
+}
+
+void World::RunChunkCodecBenchmark(int numIterations)
+{
+	if (m_activeChunks.empty() || numIterations <= 0)
+	{
+		g_console->AddLine("Cannot run chunk codec benchmark: no chunks are active");
+		return;
+	}
+
+	// The codecs work on copies, so the active chunks are left untouched
+	std::vector<ChunkSaveSnapshot> snapshots(m_activeChunks.size());
+	int snapshotIndex = 0;
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter, snapshotIndex++)
+	{
+		Chunk* chunk = chunkMapIter->second;
+		chunk->ExpandBlocks();
+		snapshots[snapshotIndex].m_coords = chunk->m_coords;
+		snapshots[snapshotIndex].m_blocks.reset(new ChunkBlocks(*chunk->m_blocks));
+		snapshots[snapshotIndex].m_saveLighting = true;
+	}
+
+	Chunk decodedChunk(this, IntVec2(0, 0));
+	int numChunkCodings = numIterations * (int)snapshots.size();
+	double numBlockMegabytes = (double)numChunkCodings * CHUNK_BLOCKS_TOTAL * 2 / (1024.0 * 1024.0);
+
+	int const chunkFileVersions[] = { CHUNK_FILE_VERSION_BLOCKS_AND_LIGHTING, CHUNK_FILE_VERSION_PACKED };
+	for (int chunkFileVersion : chunkFileVersions)
+	{
+		std::vector<std::vector<uint8_t>> chunkFiles(snapshots.size());
+
+		double encodeStartTime = GetCurrentTimeSeconds();
+		for (int iterationIndex = 0; iterationIndex < numIterations; iterationIndex++)
+		{
+			for (int chunkIndex = 0; chunkIndex < (int)snapshots.size(); chunkIndex++)
+			{
+				snapshots[chunkIndex].m_chunkFileVersion = chunkFileVersion;
+				chunkFiles[chunkIndex].clear();
+				Chunk::WriteChunkFileBuffer(snapshots[chunkIndex], this, chunkFiles[chunkIndex]);
+			}
+		}
+		double encodeEndTime = GetCurrentTimeSeconds();
+
+		int numFailedDecodes = 0;
+		for (int iterationIndex = 0; iterationIndex < numIterations; iterationIndex++)
+		{
+			for (int chunkIndex = 0; chunkIndex < (int)snapshots.size(); chunkIndex++)
+			{
+				decodedChunk.m_coords = snapshots[chunkIndex].m_coords;
+				if (!decodedChunk.LoadFromBuffer(chunkFiles[chunkIndex].data(), chunkFiles[chunkIndex].size()))
+				{
+					numFailedDecodes++;
+				}
+			}
+		}
+		double decodeEndTime = GetCurrentTimeSeconds();
+
+		size_t numChunkFileBytes = 0;
+		for (int chunkIndex = 0; chunkIndex < (int)chunkFiles.size(); chunkIndex++)
+		{
+			numChunkFileBytes += chunkFiles[chunkIndex].size();
+		}
+
+		g_console->AddLine(Stringf("Chunk codec v%d: %d bytes per chunk, encode %.1f MB/s, decode %.1f MB/s, %d failed decodes", chunkFileVersion, (int)(numChunkFileBytes / chunkFiles.size()),
+			numBlockMegabytes / (encodeEndTime - encodeStartTime), numBlockMegabytes / (decodeEndTime - encodeEndTime), numFailedDecodes));
+	}
+}
+
+void World::SolveAllDirtyLighting()
+{
+	bool didProcessLighting = true;
+	while (didProcessLighting)
+	{
+		didProcessLighting = ProcessLightingPhase(0);
+		didProcessLighting = ProcessLightingPhase(1) || didProcessLighting;
+	}
+}
+
+int World::GetNumBlocksWithIncorrectLighting() const
+{
+	// Correct lighting is the unique fixed point where every block holds the max of its own source and its brightest neighbor minus one
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
+	{
+		chunkMapIter->second->ExpandBlocks();
+	}
+
+	int numIncorrectBlocks = 0;
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
+	{
+		Chunk* chunk = chunkMapIter->second;
+		for (int blockIndex = 0; blockIndex < CHUNK_BLOCKS_TOTAL; blockIndex++)
+		{
+			if (!chunk->IsBlockLightingCorrect(blockIndex))
+			{
+				numIncorrectBlocks++;
+			}
+		}
+	}
+
+	return numIncorrectBlocks;
+}
+
+extern double g_lightingProcessingTime;
+void World::ProcessDirtyLighting()
+{
+	double lightingProcessingStartTime = GetCurrentTimeSeconds();
+	double lightingBudgetEndTime = lightingProcessingStartTime + (double)m_lightingBudgetMilliseconds * 0.001;
+
+	// Chunks are colored in a checkerboard so that no two chunks processed in the same phase are adjacent
+	// Light crossing chunk borders is picked up by the neighbor in the following phase
+	// Whatever is left once the frame budget is used up carries over to the next frame
+	bool didProcessLighting = true;
+	while (didProcessLighting && GetCurrentTimeSeconds() < lightingBudgetEndTime)
+	{
+		didProcessLighting = ProcessLightingPhase(0);
+		didProcessLighting = ProcessLightingPhase(1) || didProcessLighting;
+	}
+
+	double lightingProcessingEndTime = GetCurrentTimeSeconds();
+	g_lightingProcessingTime = (lightingProcessingEndTime - lightingProcessingStartTime) * 1000.f;
+}
+
+bool World::ProcessLightingPhase(int chunkParity)
+{
+	std::vector<std::pair<float, Chunk*>> candidateChunks;
+	for (int worklistIndex = 0; worklistIndex < (int)m_lightingWorklist.size(); worklistIndex++)
+	{
+		Chunk* chunk = m_lightingWorklist[worklistIndex];
+		if (((chunk->m_coords.x + chunk->m_coords.y) & 1) != chunkParity)
+		{
+			continue;
+		}
+		if (chunk->HasDirtyLighting())
+		{
+			candidateChunks.push_back(std::make_pair(GetChunkLightingPriority(chunk), chunk));
+		}
+	}
+
+	if (candidateChunks.empty())
+	{
+		return false;
+	}
+
+	// Only the most urgent chunks are solved in each phase so that lighting near the camera settles first
+	int numPhaseChunks = std::min((int)candidateChunks.size(), m_maxLightingChunksPerPhase);
+	std::partial_sort(candidateChunks.begin(), candidateChunks.begin() + numPhaseChunks, candidateChunks.end(), [](std::pair<float, Chunk*> const& a, std::pair<float, Chunk*> const& b) { return a.first < b.first; });
+
+	// Chunks are only ever compressed or expanded on the main thread, so everything the workers read is expanded here
+	std::vector<Chunk*> phaseChunks;
+	for (int chunkIndex = 0; chunkIndex < numPhaseChunks; chunkIndex++)
+	{
+		phaseChunks.push_back(candidateChunks[chunkIndex].second);
+		phaseChunks.back()->ExpandBlocksWithNeighbors();
+	}
+
+	if (phaseChunks.size() == 1)
+	{
+		// Not worth the round trip through the job system (e.g. a single block edit)
+		phaseChunks[0]->ProcessDirtyLighting(LIGHTING_MAX_STEPS_PER_CHUNK_PHASE);
+	}
+	else
+	{
+		for (int chunkIndex = 0; chunkIndex < (int)phaseChunks.size(); chunkIndex++)
+		{
+			g_jobSystem->QueueJob(new ChunkLightingJob(phaseChunks[chunkIndex], LIGHTING_MAX_STEPS_PER_CHUNK_PHASE));
+		}
+
+		int numOutstandingLightingJobs = (int)phaseChunks.size();
+		while (numOutstandingLightingJobs > 0)
+		{
+			Job* completedJob = g_jobSystem->GetCompletedJob();
+			if (!completedJob)
+			{
+				std::this_thread::yield();
+				continue;
+			}
+
+			ChunkLightingJob* lightingJob = dynamic_cast<ChunkLightingJob*>(completedJob);
+			if (lightingJob)
+			{
+				delete lightingJob;
+				numOutstandingLightingJobs--;
+				continue;
+			}
+
+			// Chunks cannot be activated while lighting jobs are reading their neighbors, so other jobs wait for the next frame
+			m_deferredCompletedJobs.push_back(completedJob);
+		}
+	}
+
+	// Border light changes recorded by the workers can now be applied to the neighboring meshes
+	for (int chunkIndex = 0; chunkIndex < (int)phaseChunks.size(); chunkIndex++)
+	{
+		phaseChunks[chunkIndex]->ApplyNeighborMeshDirtying();
+	}
+
+	// Workers can only hand work to neighbors through their inbound lists, so the worklist is updated here
+	for (int chunkIndex = 0; chunkIndex < (int)phaseChunks.size(); chunkIndex++)
+	{
+		Chunk* chunk = phaseChunks[chunkIndex];
+		Chunk* neighborChunks[] = { chunk->m_eastNeighbor, chunk->m_westNeighbor, chunk->m_northNeighbor, chunk->m_southNeighbor };
+		for (int neighborIndex = 0; neighborIndex < 4; neighborIndex++)
+		{
+			if (neighborChunks[neighborIndex] && neighborChunks[neighborIndex]->HasDirtyLighting())
+			{
+				AddChunkToLightingWorklist(neighborChunks[neighborIndex]);
+			}
+		}
+	}
+
+	for (int worklistIndex = 0; worklistIndex < (int)m_lightingWorklist.size(); worklistIndex++)
+	{
+		Chunk* chunk = m_lightingWorklist[worklistIndex];
+		if (!chunk->HasDirtyLighting())
+		{
+			chunk->m_isInLightingWorklist = false;
+			m_lightingWorklist[worklistIndex] = m_lightingWorklist.back();
+			m_lightingWorklist.pop_back();
+			worklistIndex--;
+		}
+	}
+
+	return true;
+}
+
+void World::CompressIdleChunk()
+{
+	// At most one chunk is compressed per frame to keep the cost of packing bounded
+	double currentTime = GetCurrentTimeSeconds();
+	Chunk* chunkToCompress = nullptr;
+
+	m_numCompressedChunks = 0;
+	m_residentBlockBytes = 0;
+	for (auto chunkMapIter = m_activeChunks.begin(); chunkMapIter != m_activeChunks.end(); ++chunkMapIter)
+	{
+		Chunk* chunk = chunkMapIter->second;
+		m_residentBlockBytes += chunk->GetResidentBlockBytes();
+		if (chunk->AreBlocksCompressed())
+		{
+			m_numCompressedChunks++;
+			continue;
+		}
+
+		if (chunkToCompress || m_chunkCompressionIdleSeconds <= 0.f)
+		{
+			continue;
+		}
+		if (currentTime - chunk->m_lastBlockAccessTime < (double)m_chunkCompressionIdleSeconds)
+		{
+			continue;
+		}
+		if (chunk->m_dirtyMeshSections != 0 || chunk->m_isInLightingWorklist || chunk->HasDirtyLighting())
+		{
+			continue;
+		}
+
+		// A neighbor that still has to be meshed or lit would expand this chunk again right away
+		bool isNeighborhoodSettled = true;
+		Chunk* neighborChunks[] = { chunk->m_eastNeighbor, chunk->m_westNeighbor, chunk->m_northNeighbor, chunk->m_southNeighbor };
+		for (int neighborIndex = 0; neighborIndex < 4; neighborIndex++)
+		{
+			Chunk* neighborChunk = neighborChunks[neighborIndex];
+			if (!neighborChunk || neighborChunk->m_dirtyMeshSections != 0 || neighborChunk->m_isInLightingWorklist)
+			{
+				isNeighborhoodSettled = false;
+				break;
+			}
+		}
+		if (isNeighborhoodSettled)
+		{
+			chunkToCompress = chunk;
+		}
+	}
+
+	if (chunkToCompress)
+	{
+		int uncompressedBytes = chunkToCompress->GetResidentBlockBytes();
+		chunkToCompress->CompressBlocks();
+		m_residentBlockBytes += chunkToCompress->GetResidentBlockBytes() - uncompressedBytes;
+		m_numCompressedChunks++;
+	}
+}
+
+void World::AddChunkToLightingWorklist(Chunk* chunk)
+{
+	if (chunk->m_isInLightingWorklist)
+	{
+		return;
+	}
+
+	chunk->m_isInLightingWorklist = true;
+	m_lightingWorklist.push_back(chunk);
+}
+
+void World::RemoveChunkFromLightingWorklist(Chunk* chunk)
+{
+	if (!chunk->m_isInLightingWorklist)
+	{
+		return;
+	}
+
+	chunk->m_isInLightingWorklist = false;
+	m_lightingWorklist.erase(std::find(m_lightingWorklist.begin(), m_lightingWorklist.end(), chunk));
 }
@@ -7,13 +7,20 @@
 #include "Engine/Math/Vec3.hpp"
 #include "Engine/Math/RaycastUtils.hpp"
 
+#include <cstdint>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <set>
 #include <string>
-#include <queue>
+#include <vector>
 
 class Chunk;
 class Game;
+class Job;
+class RegionFile;
+struct ChunkSaveSnapshot;
+enum class ChunkState;
 
 
 struct SimpleMinerRaycastResult : public RaycastResult3D
@@ -37,7 +44,24 @@ public:
 
 
 	std::string GetSaveFilePath() const;
+	ChunkState GetChunkState(IntVec2 const& chunkCoords) const;
+	bool LoadChunkManifest();
+	void RebuildChunkManifest();
+	void SaveChunkManifest() const;
+	void SaveSession() const;
+	bool RestoreSession();
+	void BeginPregeneration();
+	bool UpdatePregeneration();
+	void QueuePregenerationMeshes();
+	void WaitForChunkJobs();
 	int GetChunkFileVersion() const;
+	RegionFile* GetRegionFileForChunk(IntVec2 const& chunkCoords);
+	std::shared_ptr<ChunkSaveSnapshot const> FindChunkSaveSnapshot(IntVec2 const& chunkCoords);
+	bool ReadChunkData(IntVec2 const& chunkCoords, std::vector<uint8_t>& out_chunkData);
+	bool WriteChunkData(IntVec2 const& chunkCoords, std::vector<uint8_t> const& chunkData);
+	void QueueChunkSave(Chunk* chunk);
+	void SavePendingChunk(IntVec2 const& chunkCoords);
+	void FlushChunkSaves();
 
 	void HandleChunkActivationDeactivation();
 	void DeactivateChunk(IntVec2 const& chunkCoords);
@@ -46,6 +70,7 @@ public:
 	bool DeactivateFarthestChunkOutOfRange(float range);
 	void ActivateChunk(Chunk* chunk);
 	void DirtyChunkLighting(Chunk* chunk);
+	void DirtyLightingAcrossBorder(BlockIter const& blockIterA, BlockIter const& blockIterB);
 
 	Chunk* GetChunkAtCoords(IntVec2 const& chunkCoords) const;
 	Chunk* GetChunkForWorldPosition(Vec3 const& worldPosition) const;
@@ -53,17 +78,60 @@ public:
 	SimpleMinerRaycastResult RaycastVsBlocks(Vec3 const& startPosition, Vec3 const& direction, float maxDistance) const;
 
 	void MarkBlockLightingDirty(BlockIter blockIter);
+	void RelightBlock(BlockIter blockIter);
 	void ProcessDirtyLighting();
-	void ProcessNextDirtyLightBlock();
+	void SolveAllDirtyLighting();
+	void RunLightingStressTest(int numEdits);
+	void RunChunkCodecBenchmark(int numIterations);
+	int GetNumBlocksWithIncorrectLighting() const;
+	bool ProcessLightingPhase(int chunkParity);
+	void AddChunkToLightingWorklist(Chunk* chunk);
+	void RemoveChunkFromLightingWorklist(Chunk* chunk);
+	float GetChunkLightingPriority(Chunk const* chunk) const;
+	void HandleCompletedJob(Job* completedJob);
+	void QueueChunkReadAhead();
+	void CompressIdleChunk();
 
 public:
 	Game* m_game = nullptr;
 	int m_worldSeed = 0;
 	std::map<IntVec2, Chunk*> m_activeChunks;
 	std::set<IntVec2> m_chunkCoordsQueuedForActivation;
-	std::queue<BlockIter> m_dirtyLightingQueue;
+	// Every chunk with a file (or a queued save), so chunks without one are generated without probing the disk; only touched on the main thread
+	std::set<IntVec2> m_chunkCoordsOnDisk;
+	std::string m_saveFilePath;
+	std::vector<Job*> m_deferredCompletedJobs;
+	std::vector<Chunk*> m_lightingWorklist;
+	std::map<IntVec2, RegionFile*> m_regionFiles;
+	std::mutex m_regionFilesMutex;
+	// Saves waiting for a worker, and the ones a worker is writing right now; loads read from these before the region files
+	// A chunk has at most one save job, which keeps writing until no newer snapshot is pending, so repeated saves coalesce
+	std::map<IntVec2, std::shared_ptr<ChunkSaveSnapshot const>> m_pendingChunkSaves;
+	std::map<IntVec2, std::shared_ptr<ChunkSaveSnapshot const>> m_inFlightChunkSaves;
+	std::mutex m_chunkSavesMutex;
 	Shader* m_shader = nullptr;
 	ConstantBuffer* m_shaderConstants = nullptr;
+	float m_lightingBudgetMilliseconds = 4.f;
+	bool m_saveChunkLighting = true;
+	bool m_savePackedChunkFiles = true;
+	int m_regionReadAheadChunks = 2;
+	IntVec2 m_readAheadChunkCoords;
+	bool m_hasReadAheadChunkCoords = false;
+	// Chunks activated, lit and meshed before the first gameplay frame; the last session's chunks come first, then the spawn area
+	std::vector<IntVec2> m_pregenerationChunkCoords;
+	float m_spawnPregenerationRadius = 0.f;
+	float m_pregenerationProgress = 0.f;
+	std::string m_pregenerationStatus;
+	bool m_hasQueuedPregenerationMeshes = false;
+	bool m_isPregenerationComplete = false;
+	int m_numPregenerationMeshes = 0;
+	int m_numPendingMeshJobs = 0;
+	// Edited chunks with at most this many blocks changed from the generator's output are saved as edit deltas; 0 always saves them in full
+	int m_maxEditDeltaBlocks = 0;
+	int m_maxLightingChunksPerPhase = 1;
+	float m_chunkCompressionIdleSeconds = 10.f;
+	int m_numCompressedChunks = 0;
+	int m_residentBlockBytes = 0;
 	float m_worldTime = 0.5f;
 	float m_worldTimeScale = 200.f;
 	Rgba8 m_skyColor = Rgba8::BLACK;